@@ -0,0 +1,33 @@
+#pragma once
+
+#include <compute/blur/scene.hpp>
+
+namespace compute
+{
+
+	struct adaptive_options
+	{
+		// Target GPU blur time per frame, in milliseconds
+		float budget = 2.f;
+	};
+
+	// Parses the arguments of the adaptive mode,
+	//
+	//     blur --adaptive [--budget ms]
+	//
+	// Returns false if the arguments don't request it, throws if they are malformed
+	bool parse_adaptive_options(int argc, char ** argv, adaptive_options & options);
+
+	// Used by the adaptive scene when it is switched to from another scene
+	void set_adaptive_options(adaptive_options options);
+
+	// Keeps the blur within the budget by choosing the variant, the render scale and the
+	// kernel radius at runtime. Quality levels (render scale and kernel truncation) are
+	// ordered from best to cheapest; the controller degrades when the median measured blur
+	// time exceeds the budget, and only upgrades when the predicted time of the better level
+	// leaves a margin below it, backing off from levels it had to leave shortly after
+	// entering them. At every level it runs the fastest variant measured so far among
+	// those with the reference output, so only the scale and the radius change the image
+	std::unique_ptr<scene> adaptive(adaptive_options options);
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+namespace compute
+{
+
+	// Heap allocations made through the global operator new (which this program replaces to
+	// count them) by every thread since the start of the process. Memory the GL driver and
+	// the C library allocate with malloc directly is not counted
+	struct allocation_counters
+	{
+		std::uint64_t count = 0;
+		std::uint64_t bytes = 0;
+	};
+
+	allocation_counters allocation_count();
+
+	inline allocation_counters operator - (allocation_counters const & a, allocation_counters const & b)
+	{
+		return {a.count - b.count, a.bytes - b.bytes};
+	}
+
+}
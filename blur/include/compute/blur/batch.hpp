@@ -0,0 +1,75 @@
+#pragma once
+
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	// Blurs a batch of equally sized RGBA8 images stored as the layers of texture arrays.
+	// Images that are too small to fill the GPU on their own are blurred together, with
+	// a single dispatch per pass for the whole batch
+	struct batch_blur
+	{
+		batch_blur(float sigma, int radius);
+
+		// Reallocates the arrays, discarding their contents
+		void resize(int width, int height, int layers);
+
+		int width() const { return width_; }
+		int height() const { return height_; }
+		int layers() const { return layers_; }
+
+		// Uploads tightly packed RGBA8 pixels into a layer of the input array. As with
+		// glTexSubImage3D, pixels is an offset if a pixel unpack buffer is bound
+		void upload(int layer, void const * pixels);
+
+		// Uploads into the top left width x height corner of a layer
+		void upload(int layer, void const * pixels, int width, int height);
+
+		// Blurs count layers of the input starting at first into the output
+		void apply(int first, int count);
+
+		// Same as above, but blurs only the top left width x height corner of the layers,
+		// treating its edges as the image edges
+		void apply(int first, int count, int width, int height);
+
+		// Same as apply, but issues separate dispatches and barriers for every image,
+		// the way a single image variant would be used
+		void apply_each(int count);
+
+		// Reads back a layer of the output array as tightly packed RGBA8 pixels. As with
+		// glReadPixels, pixels is an offset if a pixel pack buffer is bound
+		void download(int layer, void * pixels);
+
+		// Reads back a rectangle of a layer of the output array
+		void download(int layer, int x, int y, int width, int height, void * pixels);
+
+		gfx::texture_2d_array & input() { return input_; }
+		gfx::texture_2d_array & output() { return output_; }
+
+		// Binds the framebuffer for reading from a layer of the output array
+		void bind_output(int layer);
+
+	private:
+		gfx::program blur_horizontal_program_;
+		gfx::program blur_vertical_program_;
+
+		gfx::texture_2d_array input_;
+		gfx::texture_2d_array intermediate_;
+		gfx::texture_2d_array output_;
+
+		gfx::framebuffer read_fbo_;
+
+		int width_ = 0;
+		int height_ = 0;
+		int layers_ = 0;
+
+		void horizontal(int first, int count, int width, int height);
+		void vertical(int first, int count, int width, int height);
+	};
+
+}
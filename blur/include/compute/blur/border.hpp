@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+namespace compute
+{
+
+	// How texels outside of the image are addressed
+	enum class border_mode
+	{
+		// The nearest edge texel
+		clamp,
+
+		// Reflected at the edges, repeating the edge texel (as GL_MIRRORED_REPEAT)
+		mirror,
+
+		// The opposite side of the image (as GL_REPEAT)
+		wrap,
+
+		// Transparent black
+		zero,
+	};
+
+	constexpr int border_mode_count = 4;
+
+	char const * border_mode_name(border_mode mode);
+
+	// GLSL int border_index(int p, int size), mapping a coordinate along one axis into
+	// the image, and float border_weight(int p, int size), the factor the texel at the
+	// mapped coordinate is multiplied by (zero outside of the image for border_mode::zero)
+	std::string border_source(border_mode mode);
+
+}
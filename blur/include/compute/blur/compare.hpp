@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <iosfwd>
+
+namespace compute
+{
+
+	struct compare_options
+	{
+		// Result files written by the benchmark
+		std::filesystem::path baseline;
+		std::filesystem::path candidate;
+
+		// Smallest relative slowdown of the median blur time that counts as a regression
+		double threshold = 0.05;
+
+		// Significance level of the one-sided Mann-Whitney U test
+		double alpha = 0.01;
+	};
+
+	// Parses the arguments of the comparison mode,
+	//
+	//     blur --compare <baseline.csv> <candidate.csv> [--threshold T] [--alpha A]
+	//
+	// which exits with status 2 if there are regressions and 1 on errors.
+	// Returns false if the arguments don't request it, throws if they are malformed
+	bool parse_compare_options(int argc, char ** argv, compare_options & options);
+
+	// Compares the blur time samples of every configuration (variant, resolution and
+	// intermediate format) present in both files. A configuration regressed if its median
+	// grew by more than the threshold and the candidate samples are significantly larger
+	// according to a Mann-Whitney U test, which doesn't assume the (typically skewed and
+	// multimodal) timings to be normally distributed. Writes a report to the stream and
+	// returns the number of regressions. Doesn't need an OpenGL context
+	int compare_results(compare_options const & options, std::ostream & output);
+
+}
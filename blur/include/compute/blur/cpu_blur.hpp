@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace compute
+{
+
+	// Separable Gaussian blur of RGBA8 images on a pool of worker threads, with the same
+	// clamp-to-edge borders and RGBA8 intermediate as the GPU variants. Blurs a range of
+	// rows of an image given only those rows and the ones within the kernel radius around
+	// them, so an image can be split into bands blurred elsewhere.
+	//
+	// The workers are persistent and the buffers only grow, so blurring the same band
+	// size again allocates nothing
+	struct cpu_blur
+	{
+		// Zero threads means one per hardware thread, the calling thread included
+		explicit cpu_blur(int threads = 0);
+		~cpu_blur();
+
+		cpu_blur(cpu_blur const &) = delete;
+		cpu_blur & operator = (cpu_blur const &) = delete;
+
+		void set_kernel(float sigma, int radius);
+
+		int radius() const { return radius_; }
+
+		// Including the calling thread
+		int threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+		// Writes rows [first, last) of the blurred width x height image into output, tightly
+		// packed. Input holds the rows [input_first, input_first + input_rows) of the source
+		// image, which must include the rows within the radius around [first, last) that
+		// are inside the image
+		void apply(std::uint8_t const * input, int input_first, int input_rows, std::uint8_t * output,
+			int width, int height, int first, int last);
+
+	private:
+		int radius_ = 0;
+		std::vector<float> weights_;
+
+		// Horizontally blurred input rows
+		std::vector<std::uint8_t> intermediate_;
+
+		// A row of float accumulators per thread for the vertical pass
+		std::vector<std::vector<float>> accumulators_;
+
+		std::vector<std::thread> workers_;
+
+		std::mutex mutex_;
+		std::condition_variable start_;
+		std::condition_variable done_;
+		std::uint64_t generation_ = 0;
+		int busy_ = 0;
+		bool stop_ = false;
+
+		// The job being run: fn(context, thread, first row, last row) for every chunk
+		void (*job_)(void const * context, int thread, int first, int last) = nullptr;
+		void const * context_ = nullptr;
+		int job_rows_ = 0;
+		int job_chunk_ = 0;
+		std::atomic<int> next_chunk_{0};
+
+		template <typename F>
+		void parallel_rows(int rows, F const & f);
+
+		void work(int thread);
+		void worker(int thread);
+	};
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	// Box-downsamples a full resolution color buffer to 1/scale of its size with a chain
+	// of 2x linear blits (a single 4x blit would only average the central 2x2 texels of
+	// each 4x4 block). Supports scales 1, 2 and 4.
+	struct downsampler
+	{
+		downsampler();
+
+		void resize(int width, int height, int scale);
+
+		// Returns the downsampled texture, or source itself for scale 1
+		gfx::texture_2d & apply(gfx::framebuffer & source_fbo, gfx::texture_2d & source);
+
+	private:
+		static constexpr int max_levels = 2;
+
+		int width_ = 0;
+		int height_ = 0;
+		int levels_ = 0;
+
+		gfx::framebuffer fbo_[max_levels];
+		gfx::texture_2d color_buffer_[max_levels];
+	};
+
+}
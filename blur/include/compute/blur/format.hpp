@@ -0,0 +1,55 @@
+#pragma once
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/texture.hpp>
+
+#include <string>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	// Storage format of the intermediate buffer between the passes of multi-pass variants,
+	// followed by the single and two channel formats of masks and luminance-like data
+	enum class pixel_format
+	{
+		rgba8,
+		rgb10a2,
+		r11g11b10f,
+		rgba16f,
+		rgba32f,
+		r8,
+		r16f,
+		rg8,
+	};
+
+	constexpr int pixel_format_count = 8;
+
+	// The intermediate buffer formats come first
+	constexpr int intermediate_format_count = 5;
+
+	char const * pixel_format_name(pixel_format format);
+
+	GLenum pixel_format_internal(pixel_format format);
+
+	// Unsigned integer format of the same size, for reading raw texels through an image unit
+	GLenum pixel_format_raw_internal(pixel_format format);
+
+	int pixel_format_bytes(pixel_format format);
+
+	int pixel_format_channels(pixel_format format);
+
+	// Allocates uninitialized storage of the given format
+	void load(gfx::texture_2d & texture, pixel_format format, int width, int height);
+
+	// GLSL shared memory packing helpers for the format: the lds_t type holding the raw
+	// texel bits, lds_t pack_lds(vec4), vec4 unpack_lds(lds_t) and lds_t lds_from_raw(uvec4)
+	// for texels read through an unsigned integer image of the same size
+	std::string pixel_format_packing_source(pixel_format format);
+
+	// GLSL image format qualifiers INPUT_FORMAT, INPUT_RAW_FORMAT and OUTPUT_FORMAT,
+	// followed by the packing helpers for the input format
+	std::string pixel_format_source(pixel_format input, pixel_format output);
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <psemek/gfx/gl.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace compute
+{
+
+	// A ring of RGBA8 frame slots in a persistently mapped buffer (ARB_buffer_storage).
+	// Producers on any thread write frames directly into the mapping, and the GL thread
+	// copies the newest one into a texture through the buffer bound as the pixel unpack
+	// buffer, with no intermediate copies on the CPU. Slots being read by the GPU are
+	// guarded by fences instead of stalling the producer or the GL thread.
+	//
+	// The newest frame wins: a producer that runs ahead of the GL thread overwrites the
+	// oldest frame not read yet, which is counted as dropped
+	struct frame_ring
+	{
+		using clock_type = std::chrono::steady_clock;
+
+		struct frame
+		{
+			// Offset of the frame in the bound pixel unpack buffer
+			std::size_t offset;
+
+			clock_type::time_point written;
+		};
+
+		// A slot a producer is writing, owned by that producer until end_write
+		struct write_slot
+		{
+			std::uint8_t * pixels = nullptr;
+			int index = -1;
+
+			explicit operator bool() const { return pixels != nullptr; }
+		};
+
+		frame_ring(int width, int height, int slots = 4);
+		~frame_ring();
+
+		frame_ring(frame_ring const &) = delete;
+		frame_ring & operator = (frame_ring const &) = delete;
+
+		int width() const { return width_; }
+		int height() const { return height_; }
+
+		// Producer side, any thread. Returns a slot to write a tightly packed frame into,
+		// blocking while every slot is being written or read. Returns an empty slot once
+		// closed. Concurrent producers get distinct slots
+		write_slot begin_write();
+
+		// Publishes the frame written into a slot returned by begin_write
+		void end_write(write_slot const & slot);
+
+		// GL thread. Binds the buffer as the pixel unpack buffer and returns the newest
+		// published frame, if any was published since the last call
+		std::optional<frame> begin_read();
+
+		// GL thread. Fences the reads of the frame returned by begin_read, and unbinds the buffer
+		void end_read();
+
+		std::size_t frames_dropped() const;
+
+		// Wakes up and refuses producers, to let them finish before the ring is destroyed
+		void close();
+
+	private:
+		enum class slot_state
+		{
+			free,
+			writing,
+			ready,
+			reading,
+		};
+
+		struct slot
+		{
+			slot_state state = slot_state::free;
+			clock_type::time_point written;
+			std::uint64_t sequence = 0;
+			GLsync fence = nullptr;
+		};
+
+		int width_;
+		int height_;
+		std::size_t frame_bytes_;
+
+		GLuint buffer_ = 0;
+		std::uint8_t * mapping_ = nullptr;
+
+		mutable std::mutex mutex_;
+		std::condition_variable released_;
+		std::vector<slot> slots_;
+		std::uint64_t next_sequence_ = 0;
+		std::size_t frames_dropped_ = 0;
+		bool closed_ = false;
+
+		int reading_ = -1;
+
+		// Releases the slots whose reads have completed, with mutex_ locked
+		void poll();
+	};
+
+}
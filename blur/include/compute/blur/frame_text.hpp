@@ -0,0 +1,32 @@
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+namespace compute
+{
+
+	namespace frame_text_detail
+	{
+
+		std::ostream & begin();
+		std::string_view end();
+
+	}
+
+	// Formats the arguments like util::to_string, but into a fixed buffer of the calling
+	// thread that is reused every frame, so building the HUD allocates nothing. The text
+	// stays valid until the next reset_frame_text() (or until the buffer wraps around,
+	// which takes far more text than a frame of HUD needs)
+	template <typename ... Args>
+	std::string_view frame_text(Args const & ... args)
+	{
+		auto & stream = frame_text_detail::begin();
+		(stream << ... << args);
+		return frame_text_detail::end();
+	}
+
+	// Called once per frame, after the text of the previous frame has been rendered
+	void reset_frame_text();
+
+}
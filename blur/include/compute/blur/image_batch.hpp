@@ -0,0 +1,36 @@
+#pragma once
+
+#include <compute/blur/scene.hpp>
+
+#include <filesystem>
+
+namespace compute
+{
+
+	struct image_batch_options
+	{
+		std::filesystem::path input;
+		std::filesystem::path output;
+
+		float sigma = 10.f;
+		int radius = 16;
+
+		// Decoding threads, the results are encoded and written by one more thread
+		int threads = 4;
+	};
+
+	// Parses the arguments of the batch mode,
+	//
+	//     blur --batch <input directory> <output directory> [--sigma S] [--radius R] [--threads N]
+	//
+	// Returns false if the arguments don't request it, throws if they are malformed
+	bool parse_image_batch_options(int argc, char ** argv, image_batch_options & options);
+
+	// Blurs every binary PPM (P6) image of the input directory into a file of the same name
+	// in the output directory. Decoding, upload, blur, readback and encoding overlap: images
+	// are decoded and encoded on worker threads, and go to and from the GPU through rings of
+	// pixel buffers guarded by fences, so the throughput is bounded by the slowest stage.
+	// Prints the throughput and the time spent in each stage once finished
+	std::unique_ptr<scene> image_batch(image_batch_options options);
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace compute
+{
+
+	// Gaussian weights for offsets -radius..radius, integrated over
+	// each pixel and normalized to unit sum
+	std::vector<float> gaussian_weights(float sigma, int radius);
+
+	// GLSL declarations of M = radius, N = 2 * M + 1 and coeffs[N]
+	std::string gaussian_kernel_source(float sigma, int radius);
+
+	// GLSL declarations of M = radius and the non-negative half coeffs[M + 1],
+	// as used by the linear sampling variants
+	std::string gaussian_half_kernel_source(float sigma, int radius);
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <compute/blur/format.hpp>
+
+#include <string>
+
+namespace compute
+{
+
+	// Layout of a square CACHE_SIZE x CACHE_SIZE shared memory tile
+	enum class lds_layout
+	{
+		// cache[x][y], as originally written: threads of a row access a column, hitting
+		// the same bank for every thread when CACHE_SIZE is a multiple of the bank count
+		column,
+
+		// cache[x][y] with each column padded by one element, which spreads the column
+		// accesses over all banks
+		column_padded,
+
+		// cache[y][x]: threads of a row access consecutive elements
+		row,
+	};
+
+	constexpr int lds_layout_count = 3;
+
+	char const * lds_layout_name(lds_layout layout);
+
+	// GLSL CACHE_STRIDE and the cache_store(p, v) / cache_load(p) macros for the layout,
+	// with elements packed in the given format. Expects CACHE_SIZE to be defined by the
+	// shader, which declares the tile as
+	//
+	//     shared lds_t cache[CACHE_SIZE * CACHE_STRIDE];
+	std::string lds_cache_source(lds_layout layout, pixel_format storage);
+
+	// Cycles through the formats worth storing a tile in: RGBA32F (plain vec4),
+	// RGBA16F (packed halfs) and RGBA8
+	pixel_format next_lds_storage(pixel_format storage);
+
+	int lds_cache_bytes(lds_layout layout, pixel_format storage, int cache_size);
+
+	// Throws if the tile doesn't fit into the shared memory of a workgroup
+	void check_lds_size(int bytes);
+
+}
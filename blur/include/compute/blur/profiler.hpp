@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+
+namespace compute
+{
+
+	// CPU frame phase profiler. Scopes are recorded into a fixed-size buffer owned by the
+	// recording thread, so recording takes no locks and allocates nothing past the first
+	// event of a thread. When profiling is off a scope costs one relaxed atomic load.
+	// GPU timer query results are placed on a separate track of the same timeline
+	namespace profiler_detail
+	{
+
+		extern std::atomic<bool> enabled;
+
+		using clock_type = std::chrono::steady_clock;
+
+		void record(char const * name, clock_type::time_point begin, clock_type::time_point end);
+
+		void query_issued(clock_type::time_point time);
+
+	}
+
+	inline bool profiling()
+	{
+		return profiler_detail::enabled.load(std::memory_order_relaxed);
+	}
+
+	// Starts a new recording, discarding the events of the previous one
+	void start_profiling();
+
+	// Stops recording and writes the recorded events as Chrome trace JSON, which
+	// chrome://tracing and Perfetto load. Returns the number of events written
+	std::size_t stop_profiling(std::filesystem::path const & path);
+
+	// Records the time between construction and destruction under the name, which must
+	// be a string literal (only the pointer is stored)
+	struct profile_scope
+	{
+		// gpu_query marks a scope that issues a GPU timer query: the query result passed to
+		// profile_gpu is drawn on the GPU track starting where the scope started. Results
+		// are matched to scopes in order, as queries complete in order. These scopes are
+		// tracked even when profiling is off, so results of queries issued before a
+		// recording started don't shift the ones issued during it
+		explicit profile_scope(char const * name, bool gpu_query = false)
+		{
+			if (profiling())
+				name_ = name;
+
+			if (name_ || gpu_query)
+				begin_ = profiler_detail::clock_type::now();
+
+			if (gpu_query)
+				profiler_detail::query_issued(begin_);
+		}
+
+		~profile_scope()
+		{
+			if (name_)
+				profiler_detail::record(name_, begin_, profiler_detail::clock_type::now());
+		}
+
+		profile_scope(profile_scope const &) = delete;
+		profile_scope & operator = (profile_scope const &) = delete;
+
+	private:
+		char const * name_ = nullptr;
+		profiler_detail::clock_type::time_point begin_;
+	};
+
+	// Records the result of the oldest unmatched GPU query scope of the calling thread.
+	// Must be called for every result of such scopes, profiling or not
+	void profile_gpu(char const * name, float ms);
+
+	// Forgets the pending GPU query scopes of the calling thread, for when their results
+	// will never arrive (the query pool that issued them is gone)
+	void profile_discard_queries();
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <compute/blur/scene.hpp>
+#include <compute/blur/format.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace compute
+{
+
+	// OpenGL features a variant can't run without
+	enum requirement : unsigned
+	{
+		requires_compute_shader = 1u << 0,
+		requires_image_load_store = 1u << 1,
+		requires_buffer_storage = 1u << 2,
+
+		// KHR_shader_subgroup with shuffles in compute shaders, and subgroups that tile a
+		// workgroup of 64 invocations
+		requires_subgroup_shuffle = 1u << 3,
+
+		// Every compute shader variant writes its output through images
+		requires_compute = requires_compute_shader | requires_image_load_store,
+	};
+
+	// Whether the current context provides every feature of the requirements mask
+	bool requirements_met(unsigned requirements);
+
+	// Names of the extensions of the requirements mask, for diagnostics
+	std::string requirement_names(unsigned requirements);
+
+	struct variant_info
+	{
+		// Unique name, as used by the benchmark and its result files
+		std::string name;
+
+		std::function<std::unique_ptr<scene>()> factory;
+
+		// Key that switches to the variant in the demo, SDLK_UNKNOWN for variants that
+		// are only reachable from another variant or by name. Keys are unique, and must
+		// not be one a variant handles itself
+		SDL_Keycode key = SDLK_UNKNOWN;
+
+		// Dispatches or draws per blurred frame, 0 if it depends on the kernel
+		int passes = 1;
+
+		// Whether the variant honours scene::render_scale()
+		bool scalable = false;
+
+		// Whether the variant produces the same image as the naive one (up to rounding): the
+		// scene blurred by the Gaussian of scene::blur_sigma() with clamp-to-edge borders,
+		// in every channel
+		bool reference_output = false;
+
+		// Whether the variant has an intermediate buffer of scene::intermediate_format()
+		bool formats = false;
+
+		// Local size of the (first) compute pass, zero for fragment shader variants
+		int workgroup_x = 0;
+		int workgroup_y = 0;
+
+		// Shared memory per workgroup for a kernel radius and intermediate format,
+		// empty if the variant doesn't use shared memory
+		std::function<int(int radius, pixel_format intermediate)> lds_bytes;
+
+		unsigned requirements = 0;
+
+		// Largest kernel radius (scene::blur_radius()) the variant can blur with on the
+		// current context, empty if there is no such limit
+		std::function<int()> max_radius;
+
+		// Whether the benchmark runs the variant
+		bool benchmark = true;
+
+		// Variant the benchmark reports the speedup of this one against, if any
+		std::string baseline = {};
+
+		// Number of images blurred per frame
+		int images = 1;
+	};
+
+	// Whether the variant can blur with the kernel radius on the current context
+	bool radius_supported(variant_info const & variant, int radius);
+
+	void register_variant(variant_info info);
+
+	// Every registered variant, sorted by name
+	std::vector<variant_info> const & variants();
+
+	// Null if there is no variant of that name
+	variant_info const * find_variant(std::string const & name);
+
+	// Registers a variant during static initialization, variants register
+	// themselves with a registrar in their translation unit
+	struct variant_registrar
+	{
+		explicit variant_registrar(variant_info info)
+		{
+			register_variant(std::move(info));
+		}
+	};
+
+}
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <compute/blur/allocation.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/services.hpp>
+#include <compute/blur/traffic.hpp>
+
 #include <psemek/app/scene.hpp>
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 
 namespace compute
@@ -9,6 +16,26 @@ namespace compute
 
 	using namespace psemek;
 
+	// Makes the rendered content a function of the frame index alone: the animation advances
+	// by a fixed timestep per drawn frame instead of by wall-clock time, and the cubes are
+	// generated from the given seed
+	struct replay_options
+	{
+		std::uint64_t seed = 0;
+		float timestep = 1.f / 60.f;
+	};
+
+	// Parses the arguments of the deterministic mode, which combines with any other mode,
+	//
+	//     blur [mode] --deterministic [--seed S] [--timestep T]
+	//
+	// and removes them from the arguments wherever they are, so that the remaining ones
+	// select the mode. Returns false if they don't request it, throws if they are malformed
+	bool parse_replay_options(int & argc, char ** argv, replay_options & options);
+
+	// Must be called before the first scene is created
+	void set_replay_options(replay_options options);
+
 	struct scene
 		: app::scene_base
 	{
@@ -23,13 +50,78 @@ namespace compute
 
 		void draw();
 
+		// Called by variants at the start of every frame with the duration (in seconds) of the
+		// previous one: counts its heap allocations, shows them at the bottom of the HUD,
+		// publishes its duration to the telemetry and reuses the frame_text buffer
+		void begin_frame(float dt);
+
+		allocation_counters frame_allocations() const;
+
+		// Forwards a measured blur time (in milliseconds) to the active listener, if any
+		void report_blur_time(float ms);
+
+		void set_blur_time_listener(std::function<void(float)> listener);
+
+		// Forwards the traffic of one blurred frame to the active listener, if any. Variants
+		// report it whenever it changes, i.e. on resize
+		void report_traffic(blur_traffic const & traffic);
+
+		void set_traffic_listener(std::function<void(blur_traffic const &)> listener);
+
+		// Called by variants once the blurred image is in the default framebuffer, before the HUD
+		void output_ready();
+
+		void set_output_listener(std::function<void()> listener);
+
+		bool paused() const;
+
+		void set_paused(bool paused);
+
+		bool deterministic() const;
+
+		// Frames drawn while not paused; in the deterministic mode the
+		// animation time is frame_index() times the timestep
+		std::uint64_t frame_index() const;
+
+		void set_frame_index(std::uint64_t index);
+
+		// Separable variants blur at 1/render_scale() of the window resolution,
+		// with the kernel scaled accordingly
+		int render_scale() const;
+
+		void set_render_scale(int scale);
+
+		int scaled_width() const;
+		int scaled_height() const;
+
+		// Storage format of the buffer between the passes of multi-pass variants
+		pixel_format intermediate_format() const;
+
+		void set_intermediate_format(pixel_format format);
+
+		float blur_sigma() const;
+		int blur_radius() const;
+
+		// Radius the kernel is truncated at, at full resolution (16 by default). Smaller
+		// radii cut off more of the tails of the same Gaussian; like sigma, blur_radius()
+		// scales it down with the render scale. Applied by on_resize
+		int kernel_radius() const;
+
+		void set_kernel_radius(int radius);
+
+		// Destroys this scene, so that it restores whatever shared state it overrode before
+		// the factory constructs its successor. Falls back to the default scene if the
+		// factory throws. Nothing of this scene may be used after the call
+		void replace_with(std::function<std::unique_ptr<scene>()> factory);
+
+		// Painter, fullscreen vertex array and program cache shared by all scenes
+		renderer_services & services() const;
+
 	private:
 
 		struct impl;
 
 		std::shared_ptr<impl> pimpl_;
-
-		void replace_with(std::unique_ptr<scene> new_scene);
 	};
 
 	std::unique_ptr<scene> default_scene();
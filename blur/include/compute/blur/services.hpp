@@ -0,0 +1,60 @@
+#pragma once
+
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/array.hpp>
+
+#include <string>
+#include <unordered_map>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	// Non-owning handle to a program held by renderer_services
+	struct shared_program
+	{
+		shared_program() = default;
+
+		explicit shared_program(gfx::program & program)
+			: program_{&program}
+		{}
+
+		void bind() const
+		{
+			program_->bind();
+		}
+
+		decltype(auto) operator[](char const * name) const
+		{
+			return (*program_)[name];
+		}
+
+	private:
+		gfx::program * program_ = nullptr;
+	};
+
+	// GL objects that don't depend on the variant or the window size, shared by every scene
+	// and kept for as long as any scene is alive. Programs are keyed by their full source, so
+	// switching back to a variant (at the same kernel and formats) compiles nothing.
+	//
+	// Query pools stay with the variants: their callbacks refer to the scene that issued the
+	// query, and must not outlive it.
+	struct renderer_services
+	{
+		gfx::painter painter;
+
+		// Empty vertex array for attribute-less fullscreen triangles
+		gfx::array fullscreen_vao;
+
+		shared_program program(std::string const & compute_source);
+		shared_program program(std::string const & vertex_source, std::string const & fragment_source);
+
+		std::size_t program_count() const;
+
+	private:
+		std::unordered_map<std::string, gfx::program> programs_;
+	};
+
+}
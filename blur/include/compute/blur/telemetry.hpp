@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+
+namespace compute
+{
+
+	// Frame and blur timings published into a ring in POSIX shared memory, so another
+	// process can watch a running renderer. The renderer is the single producer: it only
+	// ever stores to the ring and never waits for readers, which may miss records if they
+	// fall more than a ring behind. Readers detect that, and records torn by a concurrent
+	// write, through per-record sequence numbers
+
+	inline char const telemetry_default_name[] = "/blur_telemetry";
+
+	enum class telemetry_kind : unsigned
+	{
+		frame,
+		blur,
+	};
+
+	// Creates (or takes over) the shared memory segment. Throws if it can't be created or
+	// another running process is publishing into it
+	void start_telemetry(std::string const & name = telemetry_default_name);
+
+	// Does nothing until telemetry is started. Must be called from a single thread,
+	// the GL thread
+	void publish_telemetry(telemetry_kind kind, float ms);
+
+	struct monitor_options
+	{
+		std::string name = telemetry_default_name;
+
+		// Seconds between reports
+		float interval = 1.f;
+
+		// Percentiles are computed over the samples of the last window seconds
+		float window = 5.f;
+	};
+
+	// Parses the arguments of the monitor mode,
+	//
+	//     blur --monitor [--name N] [--interval S] [--window S]
+	//
+	// Returns false if the arguments don't request it, throws if they are malformed
+	bool parse_monitor_options(int argc, char ** argv, monitor_options & options);
+
+	// Tails the ring published by a renderer and periodically writes percentiles of its
+	// frame and blur times to the stream. Waits for the renderer to start, follows it
+	// across restarts and runs until the process is interrupted
+	void run_monitor(monitor_options const & options, std::ostream & output);
+
+}
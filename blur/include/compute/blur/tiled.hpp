@@ -0,0 +1,41 @@
+#pragma once
+
+#include <compute/blur/scene.hpp>
+
+#include <filesystem>
+
+namespace compute
+{
+
+	struct tiled_options
+	{
+		// Raw tightly packed RGBA8 files, rows top to bottom
+		std::filesystem::path input;
+		std::filesystem::path output;
+
+		int width = 0;
+		int height = 0;
+
+		// Size of the part of a tile written to the output, the uploaded
+		// tile is larger by the kernel radius on every side
+		int tile_size = 2048;
+
+		float sigma = 10.f;
+		int radius = 16;
+	};
+
+	// Parses the arguments of the tiled mode,
+	//
+	//     blur --tiled <input> <output> <width> <height> [--tile T] [--sigma S] [--radius R]
+	//
+	// Returns false if the arguments don't request it, throws if they are malformed
+	bool parse_tiled_options(int argc, char ** argv, tiled_options & options);
+
+	// Blurs a raw image of any size, including ones exceeding GL_MAX_TEXTURE_SIZE or the
+	// available memory. The input and output files are memory mapped and processed in
+	// tiles with an apron of the kernel radius, so the result matches a blur of the whole
+	// image with clamped edges. The rows of tile k + 1 are copied into a pixel buffer while
+	// tile k is being blurred, and only two tiles are in flight at any time
+	std::unique_ptr<scene> tiled(tiled_options options);
+
+}
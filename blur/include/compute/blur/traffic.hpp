@@ -0,0 +1,73 @@
+#pragma once
+
+#include <ostream>
+
+namespace compute
+{
+
+	// Memory traffic and arithmetic of one blurred frame, as implied by the dispatch (or draw)
+	// sizes and the shaders. Global memory bytes are the ones requested by the shaders, before
+	// any cache: variants reading every tap from a texture request far more than DRAM delivers.
+	// Only the blur passes count, not the downsampling and upsampling around them
+	struct blur_traffic
+	{
+		double global_read = 0.0;
+		double global_written = 0.0;
+
+		double lds_read = 0.0;
+		double lds_written = 0.0;
+
+		// Kernel weight multiply-adds
+		double taps = 0.0;
+
+		double global_bytes() const { return global_read + global_written; }
+		double lds_bytes() const { return lds_read + lds_written; }
+
+		// Taps per byte of global memory traffic
+		double intensity() const;
+
+		blur_traffic & operator += (blur_traffic const & other);
+	};
+
+	// A pass producing width x height pixels, each fetching texels of read_bytes straight from
+	// global memory (fetches per pixel) and writing write_bytes
+	blur_traffic direct_pass(int width, int height, double fetches, int read_bytes, int write_bytes, double taps);
+
+	// A pass whose workgroups produce tile_x x tile_y pixels each. A workgroup loads
+	// cache_elements texels of read_bytes into shared memory elements of element_bytes once,
+	// and every pixel then reads cache_reads elements
+	blur_traffic cached_pass(int width, int height, int tile_x, int tile_y, int cache_elements, int read_bytes, int element_bytes,
+		int write_bytes, double cache_reads, double taps);
+
+	// Peak global memory bandwidth (GB/s) and tap rate (Gtaps/s) of the device, zero if unknown.
+	// Set from the command line, as they can't be queried through OpenGL
+	struct throughput_peak
+	{
+		double bandwidth = 0.0;
+		double taps = 0.0;
+	};
+
+	throughput_peak const & peak();
+	void set_peak(throughput_peak peak);
+
+	// Parses the optional peak arguments, which combine with any mode,
+	//
+	//     blur [mode] [--peak-bandwidth GB/s] [--peak-taps Gtaps/s]
+	//
+	// and removes them from the arguments wherever they are, so that the remaining ones
+	// select the mode. Returns false if there are none, throws if they are malformed
+	bool parse_peak_options(int & argc, char ** argv, throughput_peak & peak);
+
+	// Achieved global and shared memory bandwidth and tap rate for a frame blurred in ms,
+	// and, if the peaks are known, the fraction of peak bandwidth and which limit the
+	// variant is closer to according to the roofline model. Written straight into the
+	// stream, so it can be part of a frame_text without allocating
+	struct throughput
+	{
+		blur_traffic traffic;
+		float ms;
+	};
+
+	std::ostream & operator << (std::ostream & stream, throughput const & value);
+
+}
@@ -0,0 +1,454 @@
+#include <compute/blur/adaptive.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		adaptive_options current_adaptive_options;
+
+		struct quality_level
+		{
+			int scale;
+
+			// At full resolution, see scene::kernel_radius
+			int radius;
+		};
+
+		// Best first: truncating the kernel a little costs less quality than halving the resolution
+		quality_level const levels[] = {
+			{1, 16},
+			{1, 12},
+			{2, 16},
+			{2, 12},
+			{4, 16},
+			{4, 8},
+		};
+
+		constexpr int level_count = std::size(levels);
+
+		// Blur times dropped after every switch, while the new variant's first frames are in
+		// flight, and blur times per decision
+		std::size_t const settle_samples = 4;
+		std::size_t const window_samples = 24;
+
+		// An upgrade needs the better level's predicted time below this fraction of the budget,
+		// and another variant at the same level a predicted time below this fraction of the
+		// current one
+		float const upgrade_margin = 0.8f;
+		float const variant_margin = 0.8f;
+
+		// Decisions to wait before upgrading into a level, doubled every time the controller
+		// has to leave the level again that soon after entering it
+		int const initial_cooldown = 2;
+		int const max_cooldown = 64;
+
+		// The radius the variants blur with at the level, see scene::blur_radius
+		int scaled_radius(quality_level const & level)
+		{
+			return std::max(1, level.radius / level.scale);
+		}
+
+		// Relative cost of a level, pixels times taps of a separable blur. Only used to predict
+		// the time of a level from a measurement at another one
+		float level_cost(quality_level const & level)
+		{
+			return (2.f * scaled_radius(level) + 1.f) / float(level.scale * level.scale);
+		}
+
+		struct adaptive_impl
+			: scene
+		{
+			explicit adaptive_impl(adaptive_options options);
+			~adaptive_impl();
+
+			void on_resize(int width, int height) override;
+
+			void on_key_down(SDL_Keycode key) override;
+
+			void present() override;
+
+		private:
+			float budget_;
+
+			std::vector<variant_info const *> candidates_;
+
+			// Latest median blur time of every candidate at every level, negative if not
+			// measured yet
+			std::vector<std::array<float, level_count>> measured_;
+
+			std::array<int, level_count> cooldown_;
+
+			std::size_t variant_ = 0;
+			int level_ = level_count - 1;
+
+			// Every candidate is measured once at the cheapest level first, so that measuring
+			// the slow ones doesn't exceed the budget by much
+			bool calibrating_ = true;
+
+			// Set once no candidate can run at any level
+			bool exhausted_ = false;
+
+			int decisions_since_switch_ = 0;
+			bool entered_by_upgrade_ = false;
+
+			std::unique_ptr<scene> current_;
+
+			std::vector<float> window_;
+			std::size_t settled_ = 0;
+
+			int original_render_scale_;
+			int original_kernel_radius_;
+
+			gfx::painter & painter_ = services().painter;
+
+			float predicted(std::size_t variant, int level) const;
+			std::size_t fastest(int level) const;
+
+			void switch_to(std::size_t variant, int level, bool upgrade);
+
+			// Switches to the fastest variant that can run at the level, or else at the
+			// nearest level where one can, preferring cheaper ones
+			void switch_to_level(int level, bool upgrade);
+
+			// Measures the candidates from this one on, then starts the control loop
+			void calibrate(std::size_t variant);
+
+			void decide(float ms);
+		};
+
+		adaptive_impl::adaptive_impl(adaptive_options options)
+			: budget_(options.budget)
+		{
+			for (auto const & variant : variants())
+				if (variant.scalable && variant.reference_output && variant.benchmark && requirements_met(variant.requirements))
+					candidates_.push_back(&variant);
+
+			if (candidates_.empty())
+				throw std::runtime_error("No variant with a render scale and the reference output is supported");
+
+			std::array<float, level_count> unmeasured;
+			unmeasured.fill(-1.f);
+			measured_.assign(candidates_.size(), unmeasured);
+
+			cooldown_.fill(initial_cooldown);
+
+			window_.reserve(window_samples);
+
+			original_render_scale_ = render_scale();
+			original_kernel_radius_ = kernel_radius();
+
+			set_blur_time_listener([this](float ms){
+				if (!current_)
+					return;
+
+				if (settled_ < settle_samples)
+					++settled_;
+				else if (window_.size() < window_samples)
+					window_.push_back(ms);
+			});
+		}
+
+		// Runs before the successor is constructed (see scene::replace_with), so these
+		// are still the settings and the listener this scene installed
+		adaptive_impl::~adaptive_impl()
+		{
+			current_.reset();
+
+			set_blur_time_listener({});
+			set_render_scale(original_render_scale_);
+			set_kernel_radius(original_kernel_radius_);
+		}
+
+		void adaptive_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (current_)
+				current_->on_resize(width, height);
+		}
+
+		void adaptive_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_MINUS)
+				budget_ = std::max(0.1f, budget_ / 1.25f);
+			else if (key == SDLK_EQUALS)
+				budget_ = std::min(100.f, budget_ * 1.25f);
+		}
+
+		// The measurement at the nearest level, scaled by the cost model. Infinite for
+		// variants that failed, and at levels whose radius the variant doesn't support
+		float adaptive_impl::predicted(std::size_t variant, int level) const
+		{
+			if (!radius_supported(*candidates_[variant], scaled_radius(levels[level])))
+				return std::numeric_limits<float>::infinity();
+
+			auto const & times = measured_[variant];
+
+			for (int distance = 0; distance < level_count; ++distance)
+			{
+				for (int other : {level - distance, level + distance})
+				{
+					if (other < 0 || other >= level_count || times[other] < 0.f)
+						continue;
+
+					return times[other] * level_cost(levels[level]) / level_cost(levels[other]);
+				}
+			}
+
+			return std::numeric_limits<float>::infinity();
+		}
+
+		std::size_t adaptive_impl::fastest(int level) const
+		{
+			std::size_t result = 0;
+			for (std::size_t v = 1; v < candidates_.size(); ++v)
+				if (predicted(v, level) < predicted(result, level))
+					result = v;
+			return result;
+		}
+
+		void adaptive_impl::switch_to(std::size_t variant, int level, bool upgrade)
+		{
+			// Destroying the variant drops its pending timer queries
+			current_.reset();
+
+			variant_ = variant;
+			level_ = level;
+			entered_by_upgrade_ = upgrade;
+			decisions_since_switch_ = 0;
+
+			window_.clear();
+			settled_ = 0;
+
+			set_render_scale(levels[level].scale);
+			set_kernel_radius(levels[level].radius);
+
+			auto const & candidate = *candidates_[variant];
+
+			if (!radius_supported(candidate, scaled_radius(levels[level])))
+			{
+				std::cout << "Adaptive: skipping " << candidate.name << " at radius " << scaled_radius(levels[level]) << ": not supported" << std::endl;
+			}
+			else
+			{
+				try
+				{
+					current_ = candidate.factory();
+					current_->on_resize(width(), height());
+					return;
+				}
+				catch (std::exception const & e)
+				{
+					// Never chosen again, its predictions are infinite from now on
+					std::cout << "Adaptive: skipping " << candidate.name << ": " << e.what() << std::endl;
+					measured_[variant].fill(std::numeric_limits<float>::infinity());
+					current_.reset();
+				}
+			}
+
+			if (calibrating_)
+				calibrate(variant + 1);
+			else
+				switch_to_level(level, false);
+		}
+
+		void adaptive_impl::switch_to_level(int level, bool upgrade)
+		{
+			for (int distance = 0; distance < level_count; ++distance)
+			{
+				for (int other : {level + distance, level - distance})
+				{
+					if (other < 0 || other >= level_count)
+						continue;
+
+					auto const variant = fastest(other);
+					if (predicted(variant, other) < std::numeric_limits<float>::infinity())
+					{
+						switch_to(variant, other, upgrade && other == level);
+						return;
+					}
+				}
+			}
+
+			exhausted_ = true;
+			std::cout << "Adaptive: no variant can run" << std::endl;
+		}
+
+		void adaptive_impl::calibrate(std::size_t variant)
+		{
+			if (variant < candidates_.size())
+			{
+				switch_to(variant, level_, false);
+				return;
+			}
+
+			calibrating_ = false;
+
+			// The best level predicted to fit, the control loop corrects the prediction
+			int level = level_count - 1;
+			while (level > 0 && predicted(fastest(level - 1), level - 1) < budget_ * upgrade_margin)
+				--level;
+
+			switch_to_level(level, true);
+		}
+
+		void adaptive_impl::decide(float ms)
+		{
+			measured_[variant_][level_] = ms;
+			++decisions_since_switch_;
+
+			if (calibrating_)
+			{
+				calibrate(variant_ + 1);
+				return;
+			}
+
+			if (ms > budget_)
+			{
+				// Leaving a level soon after upgrading into it, the next upgrade waits longer
+				if (entered_by_upgrade_ && decisions_since_switch_ <= cooldown_[level_])
+					cooldown_[level_] = std::min(max_cooldown, cooldown_[level_] * 2);
+
+				// A faster variant keeps the quality, otherwise the next cheaper level
+				auto const other = fastest(level_);
+				if (other != variant_ && predicted(other, level_) < ms * variant_margin)
+					switch_to(other, level_, false);
+				else if (level_ + 1 < level_count)
+					switch_to_level(level_ + 1, false);
+				return;
+			}
+
+			if (level_ > 0 && decisions_since_switch_ >= cooldown_[level_ - 1])
+			{
+				auto const better = fastest(level_ - 1);
+				if (predicted(better, level_ - 1) < budget_ * upgrade_margin)
+				{
+					switch_to(better, level_ - 1, true);
+					return;
+				}
+			}
+
+			auto const other = fastest(level_);
+			if (other != variant_ && predicted(other, level_) < ms * variant_margin)
+				switch_to(other, level_, false);
+		}
+
+		void adaptive_impl::present()
+		{
+			// Every switch either leaves a variant running or ends up exhausted_
+			if (!current_ && !exhausted_)
+				calibrate(0);
+
+			if (current_)
+				current_->present();
+
+			if (window_.size() >= window_samples)
+			{
+				auto middle = window_.begin() + window_.size() / 2;
+				std::nth_element(window_.begin(), middle, window_.end());
+				float const median = *middle;
+				window_.clear();
+
+				decide(median);
+			}
+
+			gfx::framebuffer::null().bind();
+			gl::Viewport(0, 0, width(), height());
+
+			gfx::painter::text_options opts;
+			opts.scale = 2.f;
+			opts.c = gfx::black;
+			opts.x = gfx::painter::x_align::right;
+			opts.y = gfx::painter::y_align::top;
+
+			float const x = width() - 20.f;
+
+			painter_.text({x, 20.f}, frame_text("Adaptive, budget ", budget_, "ms (-/= to change)"), opts);
+
+			if (exhausted_)
+			{
+				painter_.text({x, 40.f}, "No variant can run", opts);
+			}
+			else
+			{
+				painter_.text({x, 40.f}, frame_text(candidates_[variant_]->name, ", scale 1/", levels[level_].scale, ", radius ", levels[level_].radius), opts);
+
+				if (calibrating_)
+					painter_.text({x, 60.f}, frame_text("Calibrating ", variant_ + 1, "/", candidates_.size()), opts);
+				else
+					painter_.text({x, 60.f}, frame_text("Quality level ", level_count - level_, "/", level_count), opts);
+			}
+
+			painter_.render(geom::window_camera{width(), height()}.transform());
+		}
+
+	}
+
+	bool parse_adaptive_options(int argc, char ** argv, adaptive_options & options)
+	{
+		if (argc < 2 || std::string(argv[1]) != "--adaptive")
+			return false;
+
+		for (int i = 2; i < argc; i += 2)
+		{
+			std::string const name = argv[i];
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			std::string const value = argv[i + 1];
+
+			if (name == "--budget")
+				options.budget = std::stof(value);
+			else
+				throw std::runtime_error(util::to_string("Unknown option ", name));
+		}
+
+		if (!(options.budget > 0.f))
+			throw std::runtime_error("Budget must be positive");
+
+		return true;
+	}
+
+	void set_adaptive_options(adaptive_options options)
+	{
+		current_adaptive_options = options;
+	}
+
+	std::unique_ptr<scene> adaptive(adaptive_options options)
+	{
+		return std::make_unique<adaptive_impl>(options);
+	}
+
+	namespace
+	{
+
+		variant_registrar const adaptive_registrar{{
+			.name = "adaptive",
+			.factory = []{ return adaptive(current_adaptive_options); },
+			.key = SDLK_j,
+			.passes = 0,
+			.benchmark = false,
+		}};
+
+	}
+
+}
@@ -0,0 +1,66 @@
+#include <compute/blur/allocation.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		std::atomic<std::uint64_t> allocations{0};
+		std::atomic<std::uint64_t> allocated_bytes{0};
+
+		void * counted_allocation(std::size_t size, std::size_t alignment)
+		{
+			allocations.fetch_add(1, std::memory_order_relaxed);
+			allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+			if (size == 0)
+				size = 1;
+
+			void * result = nullptr;
+			if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+				result = std::malloc(size);
+			else
+				// aligned_alloc requires the size to be a multiple of the alignment
+				result = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+
+			if (!result)
+				throw std::bad_alloc{};
+
+			return result;
+		}
+
+	}
+
+	allocation_counters allocation_count()
+	{
+		return {allocations.load(std::memory_order_relaxed), allocated_bytes.load(std::memory_order_relaxed)};
+	}
+
+}
+
+// The array, nothrow and sized forms of the standard library forward to these
+
+void * operator new(std::size_t size)
+{
+	return compute::counted_allocation(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+	return compute::counted_allocation(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void * pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void * pointer, std::align_val_t) noexcept
+{
+	std::free(pointer);
+}
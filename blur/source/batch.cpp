@@ -0,0 +1,219 @@
+#include <compute/blur/batch.hpp>
+#include <compute/blur/kernel.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/geom/vector.hpp>
+#include <psemek/util/to_string.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		// M, N and coeffs are prepended by the constructor. Layers are selected by the z
+		// workgroup index, starting at u_layer_offset, and only their u_size top left corner
+		// is blurred
+
+		char const batch_blur_horizontal_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+layout(local_size_x = 64, local_size_y = 1) in;
+layout(rgba8, binding = 0) uniform restrict readonly image2DArray u_input_image;
+layout(rgba8, binding = 1) uniform restrict writeonly image2DArray u_output_image;
+
+uniform int u_layer_offset;
+uniform ivec2 u_size;
+
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
+
+shared vec4 cache[CACHE_SIZE];
+
+void main()
+{
+	ivec2 size = u_size;
+	int layer = int(gl_WorkGroupID.z) + u_layer_offset;
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
+
+	int origin = int(gl_WorkGroupID.x) * GROUP_SIZE - M;
+
+	for (int local = int(gl_LocalInvocationID.x); local < CACHE_SIZE; local += GROUP_SIZE)
+		cache[local] = imageLoad(u_input_image, ivec3(clamp(origin + local, 0, size.x - 1), pixel_coord.y, layer));
+
+	memoryBarrierShared();
+	barrier();
+
+	if (pixel_coord.x < size.x)
+	{
+		int first = int(gl_LocalInvocationID.x);
+
+		vec4 sum = vec4(0.0);
+
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * cache[first + i];
+
+		imageStore(u_output_image, ivec3(pixel_coord, layer), sum);
+	}
+}
+)";
+
+		char const batch_blur_vertical_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+layout(local_size_x = 1, local_size_y = 64) in;
+layout(rgba8, binding = 0) uniform restrict readonly image2DArray u_input_image;
+layout(rgba8, binding = 1) uniform restrict writeonly image2DArray u_output_image;
+
+uniform int u_layer_offset;
+uniform ivec2 u_size;
+
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
+
+shared vec4 cache[CACHE_SIZE];
+
+void main()
+{
+	ivec2 size = u_size;
+	int layer = int(gl_WorkGroupID.z) + u_layer_offset;
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
+
+	int origin = int(gl_WorkGroupID.y) * GROUP_SIZE - M;
+
+	for (int local = int(gl_LocalInvocationID.y); local < CACHE_SIZE; local += GROUP_SIZE)
+		cache[local] = imageLoad(u_input_image, ivec3(pixel_coord.x, clamp(origin + local, 0, size.y - 1), layer));
+
+	memoryBarrierShared();
+	barrier();
+
+	if (pixel_coord.y < size.y)
+	{
+		int first = int(gl_LocalInvocationID.y);
+
+		vec4 sum = vec4(0.0);
+
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * cache[first + i];
+
+		imageStore(u_output_image, ivec3(pixel_coord, layer), sum);
+	}
+}
+)";
+
+		int const group_size = 64;
+
+		void allocate(gfx::texture_2d_array & texture, int width, int height, int layers)
+		{
+			gl::BindTexture(gl::TEXTURE_2D_ARRAY, texture.id());
+			gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_MIN_FILTER, gl::NEAREST);
+			gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_MAG_FILTER, gl::NEAREST);
+			gl::TexImage3D(gl::TEXTURE_2D_ARRAY, 0, gl::RGBA8, width, height, layers, 0, gl::RGBA, gl::UNSIGNED_BYTE, nullptr);
+		}
+
+	}
+
+	batch_blur::batch_blur(float sigma, int radius)
+		: blur_horizontal_program_{util::to_string("#version 430\n\n", gaussian_kernel_source(sigma, radius), batch_blur_horizontal_compute)}
+		, blur_vertical_program_{util::to_string("#version 430\n\n", gaussian_kernel_source(sigma, radius), batch_blur_vertical_compute)}
+	{}
+
+	void batch_blur::resize(int width, int height, int layers)
+	{
+		width_ = width;
+		height_ = height;
+		layers_ = layers;
+
+		allocate(input_, width, height, layers);
+		allocate(intermediate_, width, height, layers);
+		allocate(output_, width, height, layers);
+	}
+
+	void batch_blur::upload(int layer, void const * pixels)
+	{
+		upload(layer, pixels, width_, height_);
+	}
+
+	void batch_blur::upload(int layer, void const * pixels, int width, int height)
+	{
+		gl::PixelStorei(gl::UNPACK_ALIGNMENT, 1);
+		gl::BindTexture(gl::TEXTURE_2D_ARRAY, input_.id());
+		gl::TexSubImage3D(gl::TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, gl::RGBA, gl::UNSIGNED_BYTE, pixels);
+	}
+
+	void batch_blur::horizontal(int first, int count, int width, int height)
+	{
+		blur_horizontal_program_.bind();
+		blur_horizontal_program_["u_layer_offset"] = first;
+		blur_horizontal_program_["u_size"] = geom::vector{width, height};
+
+		gl::BindImageTexture(0, input_.id(), 0, gl::TRUE, 0, gl::READ_ONLY, gl::RGBA8);
+		gl::BindImageTexture(1, intermediate_.id(), 0, gl::TRUE, 0, gl::WRITE_ONLY, gl::RGBA8);
+		gl::DispatchCompute((width + group_size - 1) / group_size, height, count);
+	}
+
+	void batch_blur::vertical(int first, int count, int width, int height)
+	{
+		blur_vertical_program_.bind();
+		blur_vertical_program_["u_layer_offset"] = first;
+		blur_vertical_program_["u_size"] = geom::vector{width, height};
+
+		gl::BindImageTexture(0, intermediate_.id(), 0, gl::TRUE, 0, gl::READ_ONLY, gl::RGBA8);
+		gl::BindImageTexture(1, output_.id(), 0, gl::TRUE, 0, gl::WRITE_ONLY, gl::RGBA8);
+		gl::DispatchCompute(width, (height + group_size - 1) / group_size, count);
+	}
+
+	void batch_blur::apply(int first, int count)
+	{
+		apply(first, count, width_, height_);
+	}
+
+	void batch_blur::apply(int first, int count, int width, int height)
+	{
+		gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		horizontal(first, count, width, height);
+
+		gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		vertical(first, count, width, height);
+
+		gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT | gl::FRAMEBUFFER_BARRIER_BIT | gl::TEXTURE_UPDATE_BARRIER_BIT);
+	}
+
+	void batch_blur::apply_each(int count)
+	{
+		gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		for (int layer = 0; layer < count; ++layer)
+		{
+			horizontal(layer, 1, width_, height_);
+
+			gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			vertical(layer, 1, width_, height_);
+
+			gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT | gl::FRAMEBUFFER_BARRIER_BIT | gl::TEXTURE_UPDATE_BARRIER_BIT);
+		}
+	}
+
+	void batch_blur::bind_output(int layer)
+	{
+		gl::BindFramebuffer(gl::READ_FRAMEBUFFER, read_fbo_.id());
+		gl::FramebufferTextureLayer(gl::READ_FRAMEBUFFER, gl::COLOR_ATTACHMENT0, output_.id(), 0, layer);
+	}
+
+	void batch_blur::download(int layer, void * pixels)
+	{
+		download(layer, 0, 0, width_, height_, pixels);
+	}
+
+	void batch_blur::download(int layer, int x, int y, int width, int height, void * pixels)
+	{
+		bind_output(layer);
+
+		gl::PixelStorei(gl::PACK_ALIGNMENT, 1);
+		gl::ReadPixels(x, y, width, height, gl::RGBA, gl::UNSIGNED_BYTE, pixels);
+	}
+
+}
@@ -0,0 +1,471 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		char const benchmark_output_path[] = "blur_benchmark.csv";
+
+		int const warmup_frames = 16;
+
+		// Frame rendered by every run in the deterministic mode, one second into the animation
+		std::uint64_t const replay_frame = 60;
+		std::size_t const sample_count = 128;
+
+		struct benchmark_run
+		{
+			std::size_t entry;
+			int width;
+			int height;
+			int scale;
+			pixel_format format;
+		};
+
+		struct benchmark_result
+		{
+			std::string name;
+			int width;
+			int height;
+			std::vector<float> samples;
+
+			pixel_format format = pixel_format::rgba8;
+
+			// Minimal global memory traffic of a two-pass blur: the input is read and the
+			// output written once at 4 bytes per texel, the intermediate written and read once
+			double bytes = 0.0;
+
+			// Versus the same variant at full resolution, negative if not measured
+			float psnr = -1.f;
+
+			// Name of the result of the baseline entry in the same configuration
+			std::string baseline = {};
+
+			int images = 1;
+
+			// As reported by the variant
+			blur_traffic traffic = {};
+
+			// Heap allocations during the measured frames, which should stay at zero
+			std::uint64_t allocations = 0;
+			int allocation_frames = 0;
+
+			double allocations_per_frame() const
+			{
+				return allocation_frames > 0 ? double(allocations) / allocation_frames : 0.0;
+			}
+		};
+
+		struct capture
+		{
+			int width;
+			int height;
+			std::vector<std::uint8_t> pixels;
+		};
+
+		float psnr(capture const & reference, capture const & image)
+		{
+			if (reference.width != image.width || reference.height != image.height || image.pixels.empty())
+				return -1.f;
+
+			double error = 0.0;
+			std::size_t count = 0;
+			for (std::size_t i = 0; i < image.pixels.size(); i += 4)
+			{
+				for (std::size_t c = 0; c < 3; ++c)
+				{
+					double const d = double(image.pixels[i + c]) - double(reference.pixels[i + c]);
+					error += d * d;
+					++count;
+				}
+			}
+
+			if (error == 0.0)
+				return std::numeric_limits<float>::infinity();
+
+			return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / (error / count)));
+		}
+
+		double separable_bytes(int width, int height, pixel_format format)
+		{
+			return double(width) * height * (4 + 2 * pixel_format_bytes(format) + 4);
+		}
+
+		float median(std::vector<float> samples)
+		{
+			if (samples.empty())
+				return 0.f;
+
+			auto middle = samples.begin() + samples.size() / 2;
+			std::nth_element(samples.begin(), middle, samples.end());
+			return *middle;
+		}
+
+		// Runs every registered variant the context supports at every resolution (and every render scale and intermediate
+		// format, for variants that support them) for a fixed number of frames, collecting the GPU blur times reported
+		// by the variant. The variant being measured is owned by this scene rather than
+		// pushed to the app, so it renders at the requested resolution regardless of the
+		// window size.
+		//
+		// The animation is paused while benchmarking, so reduced resolution runs can be
+		// compared against the full resolution output of the same variant. The comparison
+		// covers the part of the frame that fits into the window.
+		struct benchmark_impl
+			: scene
+		{
+			benchmark_impl();
+			~benchmark_impl();
+
+			void present() override;
+
+		private:
+			std::vector<variant_info const *> entries_;
+			std::vector<benchmark_run> runs_;
+
+			// Per entry, in run order
+			std::vector<std::vector<float>> construction_times_;
+
+			std::size_t run_index_ = 0;
+			int frame_ = 0;
+			bool finished_ = false;
+
+			bool was_paused_;
+			std::uint64_t original_frame_index_;
+			int original_render_scale_;
+			pixel_format original_format_;
+
+			std::unique_ptr<scene> current_;
+			std::vector<benchmark_result> results_;
+
+			capture reference_;
+
+			// Reported by the variant being constructed or resized, before its result exists
+			blur_traffic traffic_;
+
+			gfx::painter & painter_ = services().painter;
+
+			void start_run();
+			void next_run();
+			void finish();
+			void capture_output();
+
+			// The result of the baseline entry at the same resolution, render scale and format
+			benchmark_result const * find_baseline(benchmark_result const & result) const;
+		};
+
+		benchmark_impl::benchmark_impl()
+		{
+			for (auto const & variant : variants())
+			{
+				if (!variant.benchmark)
+					continue;
+
+				if (!requirements_met(variant.requirements))
+				{
+					std::cout << "Skipping " << variant.name << ": requires " << requirement_names(variant.requirements) << std::endl;
+					continue;
+				}
+
+				entries_.push_back(&variant);
+			}
+
+			construction_times_.resize(entries_.size());
+
+			std::vector<geom::vector<int, 2>> resolutions;
+			resolutions.push_back({1280, 720});
+			resolutions.push_back({1920, 1080});
+			resolutions.push_back({3840, 2160});
+
+			for (auto const & resolution : resolutions)
+				for (std::size_t entry = 0; entry < entries_.size(); ++entry)
+				{
+					runs_.push_back({entry, resolution[0], resolution[1], 1, pixel_format::rgba8});
+
+					if (entries_[entry]->formats)
+						for (int format = 1; format < intermediate_format_count; ++format)
+							runs_.push_back({entry, resolution[0], resolution[1], 1, static_cast<pixel_format>(format)});
+
+					if (entries_[entry]->scalable)
+						for (int scale = 2; scale <= 4; scale *= 2)
+							runs_.push_back({entry, resolution[0], resolution[1], scale, pixel_format::rgba8});
+				}
+
+			was_paused_ = paused();
+			original_frame_index_ = frame_index();
+			original_render_scale_ = render_scale();
+			original_format_ = intermediate_format();
+			set_paused(true);
+
+			set_blur_time_listener([this](float ms){
+				if (current_ && frame_ >= warmup_frames)
+					results_.back().samples.push_back(ms);
+			});
+
+			set_traffic_listener([this](blur_traffic const & traffic){
+				traffic_ = traffic;
+			});
+
+			set_output_listener([this]{
+				if (current_ && frame_ == warmup_frames)
+					capture_output();
+			});
+		}
+
+		// Runs before the next scene is constructed (see scene::replace_with), so it
+		// doesn't clear listeners or state the next scene sets up
+		benchmark_impl::~benchmark_impl()
+		{
+			set_blur_time_listener({});
+			set_traffic_listener({});
+			set_output_listener({});
+			set_paused(was_paused_);
+			set_frame_index(original_frame_index_);
+			set_render_scale(original_render_scale_);
+			set_intermediate_format(original_format_);
+		}
+
+		void benchmark_impl::capture_output()
+		{
+			auto const & run = runs_[run_index_];
+
+			capture image;
+			image.width = std::min(run.width, width());
+			image.height = std::min(run.height, height());
+			image.pixels.resize(image.width * image.height * 4);
+
+			gl::PixelStorei(gl::PACK_ALIGNMENT, 1);
+			gl::ReadPixels(0, 0, image.width, image.height, gl::RGBA, gl::UNSIGNED_BYTE, image.pixels.data());
+
+			if (run.scale == 1 && run.format == pixel_format::rgba8)
+				reference_ = std::move(image);
+			else
+				results_.back().psnr = psnr(reference_, image);
+		}
+
+		benchmark_result const * benchmark_impl::find_baseline(benchmark_result const & result) const
+		{
+			if (result.baseline.empty())
+				return nullptr;
+
+			for (auto const & other : results_)
+				if (other.name == result.baseline && other.width == result.width && other.height == result.height && other.format == result.format && !other.samples.empty())
+					return &other;
+
+			return nullptr;
+		}
+
+		void benchmark_impl::start_run()
+		{
+			auto const & run = runs_[run_index_];
+			auto const & entry = *entries_[run.entry];
+
+			traffic_ = {};
+
+			// Every variant, resolution and process blurs the same content
+			if (deterministic())
+				set_frame_index(replay_frame);
+
+			set_render_scale(run.scale);
+			set_intermediate_format(run.format);
+
+			if (!radius_supported(entry, blur_radius()))
+			{
+				std::cout << "Skipping " << entry.name << " at 1/" << run.scale << ": kernel radius " << blur_radius() << " not supported" << std::endl;
+				next_run();
+				return;
+			}
+
+			// Programs are cached by the renderer services, so only the first
+			// construction of a variant (per kernel and format) compiles them
+			util::clock<std::chrono::duration<float, std::milli>, std::chrono::high_resolution_clock> construction_clock;
+
+			try
+			{
+				current_ = entry.factory();
+				gl::Finish();
+				construction_times_[run.entry].push_back(construction_clock.restart().count());
+			}
+			catch (std::exception const & e)
+			{
+				std::cout << "Skipping " << entry.name << ": " << e.what() << std::endl;
+				next_run();
+				return;
+			}
+
+			current_->on_resize(run.width, run.height);
+
+			std::string name = entry.name;
+			std::string baseline = entry.baseline;
+			if (run.scale > 1)
+			{
+				name = util::to_string(name, "@1/", run.scale);
+				if (!baseline.empty())
+					baseline = util::to_string(baseline, "@1/", run.scale);
+			}
+
+			benchmark_result result{name, run.width, run.height, {}};
+			result.baseline = baseline;
+			result.images = entry.images;
+			result.traffic = traffic_;
+			if (entry.formats)
+			{
+				result.format = run.format;
+				result.bytes = separable_bytes(run.width / run.scale, run.height / run.scale, run.format);
+			}
+
+			// Growing the sample vector would count as an allocation of the variant
+			result.samples.reserve(sample_count);
+
+			results_.push_back(std::move(result));
+			frame_ = 0;
+		}
+
+		void benchmark_impl::next_run()
+		{
+			current_.reset();
+
+			if (++run_index_ == runs_.size())
+			{
+				finish();
+				return;
+			}
+
+			start_run();
+		}
+
+		void benchmark_impl::finish()
+		{
+			finished_ = true;
+
+			std::ofstream output(benchmark_output_path);
+			output << "variant,width,height,format,bytes,sample,blur_ms,global_bytes,lds_bytes,taps,allocations\n";
+			for (auto const & result : results_)
+				for (std::size_t i = 0; i < result.samples.size(); ++i)
+					output << result.name << ',' << result.width << ',' << result.height << ',' << pixel_format_name(result.format) << ',' << result.bytes << ',' << i << ',' << result.samples[i]
+						<< ',' << result.traffic.global_bytes() << ',' << result.traffic.lds_bytes() << ',' << result.traffic.taps << ',' << result.allocations_per_frame() << '\n';
+
+			for (auto const & result : results_)
+			{
+				std::cout << result.name << " " << result.width << "x" << result.height << ": " << median(result.samples) << "ms";
+				if (result.bytes > 0.0)
+					std::cout << ", " << pixel_format_name(result.format) << " " << result.bytes / 1e6 << "MB minimal, " << result.bytes / (median(result.samples) * 1e6) << "GB/s";
+				if (result.psnr >= 0.f)
+					std::cout << ", PSNR " << result.psnr << "dB";
+				if (result.images > 1)
+					std::cout << ", " << result.images * 1000.f / median(result.samples) << " images/s";
+				if (result.traffic.taps > 0.0)
+					std::cout << ", " << throughput{result.traffic, median(result.samples)};
+				if (result.allocations > 0)
+					std::cout << ", " << result.allocations_per_frame() << " allocations per frame";
+				if (auto baseline = find_baseline(result))
+					std::cout << ", " << median(baseline->samples) / median(result.samples) << "x vs " << baseline->name;
+				std::cout << std::endl;
+			}
+
+			for (std::size_t entry = 0; entry < entries_.size(); ++entry)
+			{
+				auto const & times = construction_times_[entry];
+				if (times.empty())
+					continue;
+
+				std::cout << entries_[entry]->name << " construction: " << times.front() << "ms first";
+				if (times.size() > 1)
+					std::cout << ", " << median(std::vector<float>(times.begin() + 1, times.end())) << "ms after";
+				std::cout << std::endl;
+			}
+
+			std::cout << "Benchmark results written to " << benchmark_output_path << std::endl;
+		}
+
+		void benchmark_impl::present()
+		{
+			if (!finished_ && !current_)
+				start_run();
+
+			if (current_)
+			{
+				// The frame capturing the output for the PSNR allocates its pixels, and is excluded
+				auto const allocations_before = allocation_count();
+				current_->present();
+				if (frame_ > warmup_frames)
+				{
+					results_.back().allocations += (allocation_count() - allocations_before).count;
+					++results_.back().allocation_frames;
+				}
+				++frame_;
+
+				if (results_.back().samples.size() >= sample_count)
+					next_run();
+			}
+
+			gfx::framebuffer::null().bind();
+			gl::Viewport(0, 0, width(), height());
+
+			gfx::painter::text_options opts;
+			opts.scale = 2.f;
+			opts.c = gfx::black;
+			opts.x = gfx::painter::x_align::left;
+			opts.y = gfx::painter::y_align::top;
+
+			if (!finished_)
+			{
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+
+				painter_.text({20.f, 20.f}, "Benchmark", opts);
+				if (!results_.empty())
+					painter_.text({20.f, 40.f}, frame_text(results_.back().name, " ", results_.back().width, "x", results_.back().height), opts);
+				painter_.text({20.f, 60.f}, frame_text("Run ", run_index_ + 1, "/", runs_.size()), opts);
+			}
+			else
+			{
+				gl::ClearColor(0.8f, 0.8f, 1.f, 0.f);
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+
+				painter_.text({20.f, 20.f}, util::to_string("Benchmark finished, results written to ", benchmark_output_path), opts);
+
+				float y = 40.f;
+				for (auto const & result : results_)
+				{
+					std::string line = util::to_string(result.name, " ", result.width, "x", result.height, ": ", median(result.samples), "ms");
+					if (result.format != pixel_format::rgba8)
+						line = util::to_string(line, ", ", pixel_format_name(result.format));
+					if (result.psnr >= 0.f)
+						line = util::to_string(line, ", PSNR ", result.psnr, "dB");
+					if (result.images > 1)
+						line = util::to_string(line, ", ", result.images * 1000.f / median(result.samples), " images/s");
+					if (auto baseline = find_baseline(result))
+						line = util::to_string(line, ", ", median(baseline->samples) / median(result.samples), "x vs ", baseline->name);
+					painter_.text({20.f, y}, line, opts);
+					y += 20.f;
+				}
+			}
+
+			painter_.render(geom::window_camera{width(), height()}.transform());
+		}
+
+	}
+
+	std::unique_ptr<scene> benchmark()
+	{
+		return std::make_unique<benchmark_impl>();
+	}
+
+}
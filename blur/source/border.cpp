@@ -0,0 +1,90 @@
+#include <compute/blur/border.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		char const clamp_border[] =
+R"(int border_index(int p, int size)
+{
+	return clamp(p, 0, size - 1);
+}
+
+float border_weight(int p, int size)
+{
+	return 1.0;
+}
+)";
+
+		// Both handle offsets of more than the image size, which happen for small images
+		// and wide kernels. GLSL leaves % undefined for negative operands, so negative
+		// coordinates are mapped to positive ones first
+		char const mirror_border[] =
+R"(int border_index(int p, int size)
+{
+	int period = 2 * size;
+	if (p < 0) p = -p - 1;
+	p %= period;
+	return (p < size) ? p : period - 1 - p;
+}
+
+float border_weight(int p, int size)
+{
+	return 1.0;
+}
+)";
+
+		char const wrap_border[] =
+R"(int border_index(int p, int size)
+{
+	if (p < 0) p += size * ((size - 1 - p) / size);
+	return p % size;
+}
+
+float border_weight(int p, int size)
+{
+	return 1.0;
+}
+)";
+
+		char const zero_border[] =
+R"(int border_index(int p, int size)
+{
+	return clamp(p, 0, size - 1);
+}
+
+float border_weight(int p, int size)
+{
+	return (p >= 0 && p < size) ? 1.0 : 0.0;
+}
+)";
+
+	}
+
+	char const * border_mode_name(border_mode mode)
+	{
+		switch (mode)
+		{
+		case border_mode::clamp: return "clamp";
+		case border_mode::mirror: return "mirror";
+		case border_mode::wrap: return "wrap";
+		case border_mode::zero: return "zero";
+		}
+		return "unknown";
+	}
+
+	std::string border_source(border_mode mode)
+	{
+		switch (mode)
+		{
+		case border_mode::clamp: return clamp_border;
+		case border_mode::mirror: return mirror_border;
+		case border_mode::wrap: return wrap_border;
+		case border_mode::zero: return zero_border;
+		}
+		return clamp_border;
+	}
+
+}
@@ -0,0 +1,247 @@
+#include <compute/blur/compare.hpp>
+
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	namespace
+	{
+
+		struct configuration
+		{
+			std::string variant;
+			int width;
+			int height;
+			std::string format;
+
+			friend bool operator < (configuration const & a, configuration const & b)
+			{
+				return std::tie(a.variant, a.width, a.height, a.format) < std::tie(b.variant, b.width, b.height, b.format);
+			}
+		};
+
+		using result_set = std::map<configuration, std::vector<double>>;
+
+		std::vector<std::string> split(std::string const & line)
+		{
+			std::vector<std::string> fields;
+			std::istringstream stream(line);
+			std::string field;
+			while (std::getline(stream, field, ','))
+				fields.push_back(field);
+			return fields;
+		}
+
+		// Columns are looked up by name, so files with additional columns still load
+		result_set load_results(std::filesystem::path const & path)
+		{
+			std::ifstream input(path);
+			if (!input)
+				throw std::runtime_error(util::to_string("Failed to open ", path.string()));
+
+			std::string line;
+			if (!std::getline(input, line))
+				throw std::runtime_error(util::to_string(path.string(), " is empty"));
+
+			auto const header = split(line);
+
+			auto column = [&](char const * name)
+			{
+				auto it = std::find(header.begin(), header.end(), name);
+				if (it == header.end())
+					throw std::runtime_error(util::to_string(path.string(), " has no ", name, " column"));
+				return static_cast<std::size_t>(it - header.begin());
+			};
+
+			std::size_t const variant = column("variant");
+			std::size_t const width = column("width");
+			std::size_t const height = column("height");
+			std::size_t const format = column("format");
+			std::size_t const time = column("blur_ms");
+
+			result_set results;
+			while (std::getline(input, line))
+			{
+				if (line.empty())
+					continue;
+
+				auto const fields = split(line);
+				if (fields.size() != header.size())
+					throw std::runtime_error(util::to_string(path.string(), ": malformed line \"", line, "\""));
+
+				configuration config{fields[variant], std::stoi(fields[width]), std::stoi(fields[height]), fields[format]};
+				results[std::move(config)].push_back(std::stod(fields[time]));
+			}
+
+			return results;
+		}
+
+		double median(std::vector<double> samples)
+		{
+			auto middle = samples.begin() + samples.size() / 2;
+			std::nth_element(samples.begin(), middle, samples.end());
+			return *middle;
+		}
+
+		// Probability of a U statistic at least as large as observed for the candidate if
+		// both samples came from the same distribution, by the normal approximation with
+		// tie and continuity corrections. Benchmark runs have over a hundred samples, far
+		// beyond the sizes the exact distribution is needed for
+		double mann_whitney_p(std::vector<double> const & baseline, std::vector<double> const & candidate)
+		{
+			struct sample
+			{
+				double value;
+				bool candidate;
+			};
+
+			std::vector<sample> all;
+			for (double v : baseline)
+				all.push_back({v, false});
+			for (double v : candidate)
+				all.push_back({v, true});
+
+			std::sort(all.begin(), all.end(), [](sample const & a, sample const & b){ return a.value < b.value; });
+
+			double const n1 = baseline.size();
+			double const n2 = candidate.size();
+			double const n = n1 + n2;
+
+			double candidate_ranks = 0.0;
+			double ties = 0.0;
+			for (std::size_t i = 0; i < all.size();)
+			{
+				std::size_t j = i;
+				while (j < all.size() && all[j].value == all[i].value)
+					++j;
+
+				// Ranks are 1-based, tied values share the average of their ranks
+				double const rank = (i + 1 + j) / 2.0;
+				for (std::size_t k = i; k < j; ++k)
+					if (all[k].candidate)
+						candidate_ranks += rank;
+
+				double const t = j - i;
+				ties += t * t * t - t;
+				i = j;
+			}
+
+			double const u = candidate_ranks - n2 * (n2 + 1.0) / 2.0;
+			double const mean = n1 * n2 / 2.0;
+			double const variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+
+			if (variance <= 0.0)
+				return 1.0;
+
+			double const z = (u - mean - 0.5) / std::sqrt(variance);
+			return 0.5 * std::erfc(z / std::sqrt(2.0));
+		}
+
+	}
+
+	bool parse_compare_options(int argc, char ** argv, compare_options & options)
+	{
+		if (argc < 2 || std::string(argv[1]) != "--compare")
+			return false;
+
+		if (argc < 4)
+			throw std::runtime_error("Usage: blur --compare <baseline.csv> <candidate.csv> [--threshold T] [--alpha A]");
+
+		options.baseline = argv[2];
+		options.candidate = argv[3];
+
+		for (int i = 4; i < argc; i += 2)
+		{
+			std::string const name = argv[i];
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			std::string const value = argv[i + 1];
+
+			if (name == "--threshold")
+				options.threshold = std::stod(value);
+			else if (name == "--alpha")
+				options.alpha = std::stod(value);
+			else
+				throw std::runtime_error(util::to_string("Unknown option ", name));
+		}
+
+		if (options.threshold < 0.0)
+			throw std::runtime_error("Threshold must not be negative");
+
+		if (options.alpha <= 0.0 || options.alpha >= 1.0)
+			throw std::runtime_error("Significance level must be between 0 and 1");
+
+		return true;
+	}
+
+	int compare_results(compare_options const & options, std::ostream & output)
+	{
+		auto const baseline = load_results(options.baseline);
+		auto const candidate = load_results(options.candidate);
+
+		int regressions = 0;
+		int improvements = 0;
+		int compared = 0;
+
+		for (auto const & [config, candidate_samples] : candidate)
+		{
+			auto it = baseline.find(config);
+			if (it == baseline.end() || it->second.empty() || candidate_samples.empty())
+			{
+				output << config.variant << " " << config.width << "x" << config.height << " " << config.format << ": not in the baseline\n";
+				continue;
+			}
+
+			auto const & baseline_samples = it->second;
+			++compared;
+
+			double const baseline_median = median(baseline_samples);
+			double const candidate_median = median(candidate_samples);
+			double const change = candidate_median / baseline_median - 1.0;
+
+			double const slower_p = mann_whitney_p(baseline_samples, candidate_samples);
+			double const faster_p = mann_whitney_p(candidate_samples, baseline_samples);
+
+			char const * verdict = "";
+			if (change > options.threshold && slower_p < options.alpha)
+			{
+				verdict = "  REGRESSION";
+				++regressions;
+			}
+			else if (-change > options.threshold && faster_p < options.alpha)
+			{
+				verdict = "  improvement";
+				++improvements;
+			}
+
+			output << config.variant << " " << config.width << "x" << config.height << " " << config.format << ": "
+				<< baseline_median << "ms -> " << candidate_median << "ms (" << (change >= 0.0 ? "+" : "") << change * 100.0 << "%, p = "
+				<< std::min(slower_p, faster_p) << ")" << verdict << "\n";
+		}
+
+		for (auto const & [config, samples] : baseline)
+			if (!candidate.contains(config))
+				output << config.variant << " " << config.width << "x" << config.height << " " << config.format << ": missing from the candidate\n";
+
+		output << compared << " configurations compared, " << regressions << " regressions, " << improvements << " improvements"
+			<< " (threshold " << options.threshold * 100.0 << "%, alpha " << options.alpha << ")" << std::endl;
+
+		return regressions;
+	}
+
+}
@@ -1,4 +1,7 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
 
 #include <psemek/gfx/array.hpp>
 #include <psemek/gfx/program.hpp>
@@ -10,7 +13,6 @@
 #include <psemek/gfx/query.hpp>
 #include <psemek/geom/camera.hpp>
 #include <psemek/util/clock.hpp>
-#include <psemek/util/to_string.hpp>
 #include <psemek/util/moving_average.hpp>
 
 namespace compute
@@ -113,14 +115,16 @@ void main()
 			gfx::framebuffer fbo_2_;
 			gfx::texture_2d color_buffer_2_;
 
-			gfx::program blur_program_{compute_compute};
+			shared_program blur_program_ = services().program(compute_compute);
 
-			gfx::painter painter_;
+			gfx::painter & painter_ = services().painter;
 
 			gfx::query_pool queries_;
 
 			util::moving_average<float> frame_time_{32};
 			util::moving_average<float> blur_time_{32};
+
+			blur_traffic traffic() const;
 		};
 
 		compute_impl::compute_impl()
@@ -148,12 +152,23 @@ void main()
 
 			fbo_1_.assert_complete();
 			fbo_2_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic compute_impl::traffic() const
+		{
+			// The kernel is fixed at M = 16
+			int const n = 33;
+
+			return direct_pass(width(), height(), n * n, 4, 4, n * n);
 		}
 
 		void compute_impl::present()
 		{
 			float const dt = clock_.restart().count();
 			frame_time_.push(dt);
+			begin_frame(dt);
 
 			fbo_1_.bind();
 			scene::draw();
@@ -161,7 +176,9 @@ void main()
 			fbo_2_.bind();
 
 			{
-				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); });
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
 
 				gl::Clear(gl::COLOR_BUFFER_BIT);
 				gl::Disable(gl::DEPTH_TEST);
@@ -185,6 +202,8 @@ void main()
 			gfx::framebuffer::null().bind();
 
 			{
+				profile_scope const hud_scope{"hud text"};
+
 				gfx::painter::text_options opts;
 				opts.scale = 2.f;
 				opts.c = gfx::black;
@@ -193,15 +212,24 @@ void main()
 
 				painter_.text({20.f, 20.f}, "Compute", opts);
 
-				painter_.text({20.f, 40.f}, util::to_string("FPS: ", 1.f / frame_time_.average()), opts);
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
 
 				if (blur_time_.count() > 0)
-					painter_.text({20.f, 60.f}, util::to_string("Blur: ", blur_time_.average(), "ms"), opts);
+				{
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 80.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+				}
 			}
 
-			painter_.render(geom::window_camera{width(), height()}.transform());
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
 
-			queries_.poll();
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
 		}
 
 	}
@@ -217,4 +245,19 @@ void main()
 		return std::make_unique<compute_impl>();
 	}
 
+	namespace
+	{
+
+		variant_registrar const compute_registrar{{
+			.name = "compute",
+			.factory = compute,
+			.key = SDLK_4,
+			.reference_output = true,
+			.workgroup_x = 16,
+			.workgroup_y = 16,
+			.requirements = requires_compute,
+		}};
+
+	}
+
 }
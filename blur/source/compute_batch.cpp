@@ -0,0 +1,241 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/batch.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace compute
+{
+
+	std::unique_ptr<scene> compute_batch(int batch_size, bool single_dispatch);
+
+	namespace
+	{
+
+		int const thumbnail_size = 256;
+
+		int const max_batch_size = 256;
+
+		// A checkerboard of a distinct color per image, so that the blurred images can be told apart
+		std::vector<std::uint8_t> thumbnail(int index)
+		{
+			std::uint8_t const r = (index * 97) % 256;
+			std::uint8_t const g = (index * 57 + 128) % 256;
+			std::uint8_t const b = (index * 31 + 64) % 256;
+
+			int const cell = 8 << (index % 4);
+
+			std::vector<std::uint8_t> pixels(thumbnail_size * thumbnail_size * 4);
+			for (int y = 0; y < thumbnail_size; ++y)
+			{
+				for (int x = 0; x < thumbnail_size; ++x)
+				{
+					auto p = pixels.data() + (y * thumbnail_size + x) * 4;
+					bool const dark = ((x / cell) + (y / cell)) % 2 == 0;
+					p[0] = dark ? r : 255;
+					p[1] = dark ? g : 255;
+					p[2] = dark ? b : 255;
+					p[3] = 255;
+				}
+			}
+			return pixels;
+		}
+
+		// Blurs a batch of thumbnails, either with one dispatch per pass for the whole batch
+		// or with a dispatch per image and pass, and shows as many of them as fit the window
+		struct compute_batch_impl
+			: scene
+		{
+			compute_batch_impl(int batch_size, bool single_dispatch);
+
+			void on_key_down(SDL_Keycode key) override;
+
+			void present() override;
+
+		private:
+			int batch_size_;
+			bool single_dispatch_;
+
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			batch_blur blur_;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			blur_traffic traffic() const;
+		};
+
+		compute_batch_impl::compute_batch_impl(int batch_size, bool single_dispatch)
+			: batch_size_(batch_size)
+			, single_dispatch_(single_dispatch)
+			, blur_(blur_sigma(), blur_radius())
+		{
+			blur_.resize(thumbnail_size, thumbnail_size, batch_size_);
+
+			for (int i = 0; i < batch_size_; ++i)
+				blur_.upload(i, thumbnail(i).data());
+
+			report_traffic(traffic());
+		}
+
+		void compute_batch_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_MINUS && batch_size_ > 1)
+			{
+				replace_with([size = batch_size_ / 2, single = single_dispatch_]{ return compute_batch(size, single); });
+			}
+			else if (key == SDLK_EQUALS && batch_size_ < max_batch_size)
+			{
+				replace_with([size = batch_size_ * 2, single = single_dispatch_]{ return compute_batch(size, single); });
+			}
+			else if (key == SDLK_n)
+			{
+				replace_with([size = batch_size_, single = !single_dispatch_]{ return compute_batch(size, single); });
+			}
+		}
+
+		blur_traffic compute_batch_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+
+			// Workgroups never straddle two layers, so the batch counts as one image with the
+			// layers stacked across the rows for the horizontal pass and along them for the vertical
+			blur_traffic traffic = cached_pass(thumbnail_size, thumbnail_size * batch_size_, 64, 1, 64 + 2 * m, 4, 16, 4, n, n);
+			traffic += cached_pass(thumbnail_size * batch_size_, thumbnail_size, 1, 64, 64 + 2 * m, 4, 16, 4, n, n);
+			return traffic;
+		}
+
+		void compute_batch_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				if (single_dispatch_)
+					blur_.apply(0, batch_size_);
+				else
+					blur_.apply_each(batch_size_);
+			}
+
+			gfx::framebuffer::null().bind();
+			gl::ClearColor(0.8f, 0.8f, 1.f, 0.f);
+			gl::Clear(gl::COLOR_BUFFER_BIT);
+
+			int const columns = std::max(1, width() / thumbnail_size);
+			int const rows = std::max(1, height() / thumbnail_size);
+
+			for (int i = 0; i < std::min(batch_size_, columns * rows); ++i)
+			{
+				int const x = (i % columns) * thumbnail_size;
+				int const y = (i / columns) * thumbnail_size;
+
+				blur_.bind_output(i);
+				gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+				gl::BlitFramebuffer(0, 0, thumbnail_size, thumbnail_size, x, y, x + thumbnail_size, y + thumbnail_size, gl::COLOR_BUFFER_BIT, gl::NEAREST);
+			}
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, frame_text("Compute batch of ", batch_size_, " ", thumbnail_size, "x", thumbnail_size, " images (",
+					single_dispatch_ ? "single dispatch" : "dispatch per image", ")"), opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+				{
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 80.f}, frame_text("Throughput: ", batch_size_ * 1000.f / blur_time_.average(), " images/s"), opts);
+					painter_.text({20.f, 100.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+				}
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> compute_batch(int batch_size, bool single_dispatch)
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<compute_batch_impl>(batch_size, single_dispatch);
+	}
+
+	namespace
+	{
+
+		bool const compute_batch_registered = []
+		{
+			for (int batch_size = 1; batch_size <= 256; batch_size *= 4)
+			{
+				auto const each = util::to_string("compute_batch_each_", batch_size);
+
+				for (bool single_dispatch : {true, false})
+					register_variant({
+						.name = single_dispatch ? util::to_string("compute_batch_", batch_size) : each,
+						.factory = [batch_size, single_dispatch]{ return compute_batch(batch_size, single_dispatch); },
+						.key = (batch_size == 64 && single_dispatch) ? SDLK_d : SDLK_UNKNOWN,
+						.passes = single_dispatch ? 2 : 2 * batch_size,
+						.workgroup_x = 64,
+						.workgroup_y = 1,
+						.lds_bytes = [](int radius, pixel_format){ return (64 + 2 * radius) * 16; },
+						.requirements = requires_compute,
+						.baseline = single_dispatch ? each : std::string{},
+						.images = batch_size,
+					});
+			}
+
+			return true;
+		}();
+
+	}
+
+}
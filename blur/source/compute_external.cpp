@@ -0,0 +1,255 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/batch.hpp>
+#include <compute/blur/frame_ring.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/moving_average.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		int const frame_width = 1280;
+		int const frame_height = 720;
+
+		// Rate of the simulated capture process
+		auto const frame_interval = std::chrono::microseconds(1000000 / 60);
+
+		// Blurs frames produced by another thread, standing in for an external capture
+		// process, which are written straight into a persistently mapped frame_ring
+		struct compute_external_impl
+			: scene
+		{
+			compute_external_impl();
+			~compute_external_impl();
+
+			void present() override;
+
+		private:
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			frame_ring ring_;
+			batch_blur blur_;
+
+			std::atomic<bool> stop_{false};
+			std::thread producer_;
+
+			struct pending_frame
+			{
+				GLsync fence;
+				frame_ring::clock_type::time_point written;
+			};
+
+			// Frames being blurred, latency is measured once their fences signal. At most a few
+			// frames are in flight, and unlike a deque the vector stops allocating once it has
+			// grown to that
+			std::vector<pending_frame> pending_;
+
+			std::size_t frames_received_ = 0;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+			util::moving_average<float> latency_{32};
+
+			void produce();
+
+			blur_traffic traffic() const;
+		};
+
+		compute_external_impl::compute_external_impl()
+			: ring_(frame_width, frame_height)
+			, blur_(blur_sigma(), blur_radius())
+		{
+			blur_.resize(frame_width, frame_height, 1);
+
+			producer_ = std::thread([this]{ produce(); });
+
+			report_traffic(traffic());
+		}
+
+		compute_external_impl::~compute_external_impl()
+		{
+			stop_ = true;
+			ring_.close();
+			producer_.join();
+
+			for (auto const & frame : pending_)
+				gl::DeleteSync(frame.fence);
+		}
+
+		// Moving diagonal stripes, written a row at a time like a capture would deliver them
+		void compute_external_impl::produce()
+		{
+			auto next = std::chrono::steady_clock::now();
+
+			for (int index = 0; !stop_; ++index)
+			{
+				auto const slot = ring_.begin_write();
+				if (!slot)
+					break;
+
+				std::uint8_t * pixels = slot.pixels;
+
+				{
+					profile_scope const scope{"produce frame"};
+
+					for (int y = 0; y < frame_height; ++y)
+					{
+						std::uint8_t * row = pixels + std::size_t(y) * frame_width * 4;
+						for (int x = 0; x < frame_width; ++x)
+						{
+							bool const stripe = ((x + y + index * 4) / 32) % 2 == 0;
+							row[x * 4 + 0] = stripe ? 255 : 32;
+							row[x * 4 + 1] = stripe ? 192 : 32;
+							row[x * 4 + 2] = stripe ? 64 : 96;
+							row[x * 4 + 3] = 255;
+						}
+					}
+				}
+
+				ring_.end_write(slot);
+
+				next += frame_interval;
+				std::this_thread::sleep_until(next);
+			}
+		}
+
+		blur_traffic compute_external_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+
+			blur_traffic traffic = cached_pass(frame_width, frame_height, 64, 1, 64 + 2 * m, 4, 16, 4, n, n);
+			traffic += cached_pass(frame_width, frame_height, 1, 64, 64 + 2 * m, 4, 16, 4, n, n);
+			return traffic;
+		}
+
+		void compute_external_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			auto frame = ring_.begin_read();
+			if (frame)
+			{
+				// Copies from the mapped buffer into the texture on the GPU timeline
+				blur_.upload(0, reinterpret_cast<void const *>(frame->offset));
+				ring_.end_read();
+				++frames_received_;
+			}
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				blur_.apply(0, 1);
+			}
+
+			if (frame)
+				pending_.push_back({gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0), frame->written});
+
+			while (!pending_.empty() && gl::ClientWaitSync(pending_.front().fence, 0, 0) != gl::TIMEOUT_EXPIRED)
+			{
+				auto const latency = frame_ring::clock_type::now() - pending_.front().written;
+				latency_.push(std::chrono::duration<float, std::milli>(latency).count());
+				gl::DeleteSync(pending_.front().fence);
+				pending_.erase(pending_.begin());
+			}
+
+			blur_.bind_output(0);
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, 0, frame_width, frame_height, 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, gl::LINEAR);
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, frame_text("Compute external frames (", frame_width, "x", frame_height, ")"), opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (latency_.count() > 0)
+					painter_.text({20.f, 80.f}, frame_text("Latency from write to blurred: ", latency_.average(), "ms"), opts);
+
+				painter_.text({20.f, 100.f}, frame_text("Frames received: ", frames_received_, ", dropped: ", ring_.frames_dropped()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> compute_external()
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		if (!gl::sys::ext_ARB_buffer_storage())
+			throw std::runtime_error("OpenGL extension ARB_buffer_storage not supported");
+
+		return std::make_unique<compute_external_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const compute_external_registrar{{
+			.name = "compute_external",
+			.factory = compute_external,
+			.key = SDLK_g,
+			.passes = 2,
+			.workgroup_x = 64,
+			.workgroup_y = 1,
+			.lds_bytes = [](int radius, pixel_format){ return (64 + 2 * radius) * 16; },
+			.requirements = requires_compute | requires_buffer_storage,
+			.benchmark = false,
+		}};
+
+	}
+
+}
@@ -1,4 +1,8 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/lds.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
 
 #include <psemek/gfx/array.hpp>
 #include <psemek/gfx/program.hpp>
@@ -16,12 +20,15 @@
 namespace compute
 {
 
+	std::unique_ptr<scene> compute_lds(lds_layout layout, pixel_format storage);
+
 	namespace
 	{
 
-		char const compute_lds_compute[] =
-R"(#version 430
+		// The cache layout and packing macros are prepended by make_program
 
+		char const compute_lds_compute[] =
+R"(
 const int GROUP_SIZE = 16;
 
 layout(local_size_x = 16, local_size_y = 16) in;
@@ -68,14 +75,14 @@ const float coeffs[N] = float[N](
 	0.012318109844189502
 );
 
-shared vec4 cache[GROUP_SIZE + 2 * M][GROUP_SIZE + 2 * M];
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
 
-const int LOAD = (GROUP_SIZE + 2 * M) / GROUP_SIZE;
+shared lds_t cache[CACHE_SIZE * CACHE_STRIDE];
+
+const int LOAD = CACHE_SIZE / GROUP_SIZE;
 
 void main()
 {
-//	ivec2 u_direction = ivec2(1, 0);
-
 	ivec2 size = imageSize(u_input_image);
 	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
 
@@ -91,7 +98,7 @@ void main()
 
 			if (pc.x >= 0 && pc.y >= 0 && pc.x < size.x && pc.y < size.y)
 			{
-				cache[local.x][local.y] = imageLoad(u_input_image, pc);
+				cache_store(local, imageLoad(u_input_image, pc));
 			}
 		}
 	}
@@ -115,7 +122,7 @@ void main()
 
 				ivec2 local = pc - workgroup_origin;
 
-				sum += coeffs[i] * coeffs[j] * cache[local.x][local.y];
+				sum += coeffs[i] * coeffs[j] * cache_load(local);
 			}
 		}
 
@@ -127,10 +134,12 @@ void main()
 		struct compute_lds_impl
 			: scene
 		{
-			compute_lds_impl();
+			compute_lds_impl(lds_layout layout, pixel_format storage);
 
 			void on_resize(int width, int height) override;
 
+			void on_key_down(SDL_Keycode key) override;
+
 			void present() override;
 
 		private:
@@ -143,17 +152,32 @@ void main()
 			gfx::framebuffer fbo_2_;
 			gfx::texture_2d color_buffer_2_;
 
-			gfx::program blur_program_{compute_lds_compute};
+			lds_layout layout_;
+			pixel_format storage_;
+			int lds_bytes_;
 
-			gfx::painter painter_;
+			shared_program blur_program_;
+
+			gfx::painter & painter_ = services().painter;
 
 			gfx::query_pool queries_;
 
 			util::moving_average<float> frame_time_{32};
 			util::moving_average<float> blur_time_{32};
+
+			shared_program make_program() const;
+
+			blur_traffic traffic() const;
 		};
 
-		compute_lds_impl::compute_lds_impl()
+		// The kernel radius is fixed, so is the tile size
+		int const compute_lds_cache_size = 16 + 2 * 16;
+
+		compute_lds_impl::compute_lds_impl(lds_layout layout, pixel_format storage)
+			: layout_{layout}
+			, storage_{storage}
+			, lds_bytes_{lds_cache_bytes(layout, storage, compute_lds_cache_size)}
+			, blur_program_{make_program()}
 		{
 			color_buffer_1_.linear_filter();
 			color_buffer_1_.clamp();
@@ -162,6 +186,13 @@ void main()
 			color_buffer_2_.clamp();
 		}
 
+		shared_program compute_lds_impl::make_program() const
+		{
+			check_lds_size(lds_bytes_);
+
+			return services().program(util::to_string("#version 430\n\n", lds_cache_source(layout_, storage_), compute_lds_compute));
+		}
+
 		void compute_lds_impl::on_resize(int width, int height)
 		{
 			scene::on_resize(width, height);
@@ -178,12 +209,37 @@ void main()
 
 			fbo_1_.assert_complete();
 			fbo_2_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		void compute_lds_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_l)
+			{
+				replace_with([layout = static_cast<lds_layout>((static_cast<int>(layout_) + 1) % lds_layout_count), storage = storage_]{ return compute_lds(layout, storage); });
+			}
+			else if (key == SDLK_p)
+			{
+				replace_with([layout = layout_, storage = next_lds_storage(storage_)]{ return compute_lds(layout, storage); });
+			}
+		}
+
+		blur_traffic compute_lds_impl::traffic() const
+		{
+			// The kernel is fixed at M = 16, every 16x16 workgroup caches a 48x48 tile
+			int const n = 33;
+
+			return cached_pass(width(), height(), 16, 16, compute_lds_cache_size * compute_lds_cache_size, 4, pixel_format_bytes(storage_), 4, n * n, n * n);
 		}
 
 		void compute_lds_impl::present()
 		{
 			float const dt = clock_.restart().count();
 			frame_time_.push(dt);
+			begin_frame(dt);
 
 			fbo_1_.bind();
 			scene::draw();
@@ -191,7 +247,9 @@ void main()
 			fbo_2_.bind();
 
 			{
-				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); });
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
 
 				gl::Clear(gl::COLOR_BUFFER_BIT);
 				gl::Disable(gl::DEPTH_TEST);
@@ -215,28 +273,41 @@ void main()
 			gfx::framebuffer::null().bind();
 
 			{
+				profile_scope const hud_scope{"hud text"};
+
 				gfx::painter::text_options opts;
 				opts.scale = 2.f;
 				opts.c = gfx::black;
 				opts.x = gfx::painter::x_align::left;
 				opts.y = gfx::painter::y_align::top;
 
-				painter_.text({20.f, 20.f}, "Compute LDS", opts);
+				painter_.text({20.f, 20.f}, frame_text("Compute LDS (", lds_layout_name(layout_), ", ", pixel_format_name(storage_), ")"), opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
 
-				painter_.text({20.f, 40.f}, util::to_string("FPS: ", 1.f / frame_time_.average()), opts);
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				painter_.text({20.f, 80.f}, frame_text("LDS: ", lds_bytes_, " bytes per workgroup"), opts);
 
 				if (blur_time_.count() > 0)
-					painter_.text({20.f, 60.f}, util::to_string("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 100.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
 			}
 
-			painter_.render(geom::window_camera{width(), height()}.transform());
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
 
-			queries_.poll();
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
 		}
 
 	}
 
-	std::unique_ptr<scene> compute_lds()
+	std::unique_ptr<scene> compute_lds(lds_layout layout, pixel_format storage)
 	{
 		if (!gl::sys::ext_ARB_compute_shader())
 			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
@@ -244,7 +315,47 @@ void main()
 		if (!gl::sys::ext_ARB_shader_image_load_store())
 			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
 
-		return std::make_unique<compute_lds_impl>();
+		return std::make_unique<compute_lds_impl>(layout, storage);
+	}
+
+	namespace
+	{
+
+		// Column layout with plain vec4 storage is the variant as originally written
+		struct compute_lds_variant
+		{
+			char const * suffix;
+			lds_layout layout;
+			pixel_format storage;
+			SDL_Keycode key;
+		};
+
+		bool const compute_lds_registered = []
+		{
+			compute_lds_variant const list[] =
+			{
+				{"", lds_layout::column, pixel_format::rgba32f, SDLK_5},
+				{"_column_padded", lds_layout::column_padded, pixel_format::rgba32f, SDLK_UNKNOWN},
+				{"_row", lds_layout::row, pixel_format::rgba32f, SDLK_UNKNOWN},
+				{"_row_half", lds_layout::row, pixel_format::rgba16f, SDLK_UNKNOWN},
+				{"_row_rgba8", lds_layout::row, pixel_format::rgba8, SDLK_UNKNOWN},
+			};
+
+			for (auto const & v : list)
+				register_variant({
+					.name = util::to_string("compute_lds", v.suffix),
+					.factory = [v]{ return compute_lds(v.layout, v.storage); },
+					.key = v.key,
+					.reference_output = true,
+					.workgroup_x = 16,
+					.workgroup_y = 16,
+					.lds_bytes = [v](int, pixel_format){ return lds_cache_bytes(v.layout, v.storage, compute_lds_cache_size); },
+					.requirements = requires_compute,
+				});
+
+			return true;
+		}();
+
 	}
 
 }
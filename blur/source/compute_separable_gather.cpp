@@ -0,0 +1,380 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		// M, N and coeffs are prepended by make_program
+
+		// Workgroups blur two rows at once, so that every 2x2 block fetched by a set of
+		// four gathers (one per channel) is fully used when filling the cache
+		char const compute_separable_gather_horizontal_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+layout(local_size_x = 64, local_size_y = 2) in;
+uniform sampler2D u_input_texture;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
+
+const int CACHE_PAIRS = (CACHE_SIZE + 1) / 2;
+
+shared vec4 cache[2][2 * CACHE_PAIRS];
+
+void main()
+{
+	ivec2 size = imageSize(u_output_image);
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
+	vec2 texel = 1.0 / vec2(size);
+
+	int origin = int(gl_WorkGroupID.x) * GROUP_SIZE - M;
+	int row = int(gl_WorkGroupID.y) * 2;
+
+	for (int p = int(gl_LocalInvocationIndex); p < CACHE_PAIRS; p += 2 * GROUP_SIZE)
+	{
+		// The corner between texels (x, row) and (x + 1, row + 1), the texture
+		// clamps the texels outside of the image to its edge
+		vec2 tc = vec2(origin + 2 * p + 1, row + 1) * texel;
+
+		vec4 r = textureGather(u_input_texture, tc, 0);
+		vec4 g = textureGather(u_input_texture, tc, 1);
+		vec4 b = textureGather(u_input_texture, tc, 2);
+		vec4 a = textureGather(u_input_texture, tc, 3);
+
+		// Gather returns the texels in the order (0, 1), (1, 1), (1, 0), (0, 0)
+		cache[0][2 * p    ] = vec4(r.w, g.w, b.w, a.w);
+		cache[0][2 * p + 1] = vec4(r.z, g.z, b.z, a.z);
+		cache[1][2 * p    ] = vec4(r.x, g.x, b.x, a.x);
+		cache[1][2 * p + 1] = vec4(r.y, g.y, b.y, a.y);
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	if (pixel_coord.x < size.x && pixel_coord.y < size.y)
+	{
+		int local_row = int(gl_LocalInvocationID.y);
+		int first = int(gl_LocalInvocationID.x);
+
+		vec4 sum = vec4(0.0);
+
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * cache[local_row][first + i];
+
+		imageStore(u_output_image, pixel_coord, sum);
+	}
+}
+)";
+
+		char const compute_separable_gather_vertical_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+layout(local_size_x = 2, local_size_y = 64) in;
+uniform sampler2D u_input_texture;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
+
+const int CACHE_PAIRS = (CACHE_SIZE + 1) / 2;
+
+shared vec4 cache[2][2 * CACHE_PAIRS];
+
+void main()
+{
+	ivec2 size = imageSize(u_output_image);
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
+	vec2 texel = 1.0 / vec2(size);
+
+	int column = int(gl_WorkGroupID.x) * 2;
+	int origin = int(gl_WorkGroupID.y) * GROUP_SIZE - M;
+
+	for (int p = int(gl_LocalInvocationIndex); p < CACHE_PAIRS; p += 2 * GROUP_SIZE)
+	{
+		vec2 tc = vec2(column + 1, origin + 2 * p + 1) * texel;
+
+		vec4 r = textureGather(u_input_texture, tc, 0);
+		vec4 g = textureGather(u_input_texture, tc, 1);
+		vec4 b = textureGather(u_input_texture, tc, 2);
+		vec4 a = textureGather(u_input_texture, tc, 3);
+
+		cache[0][2 * p    ] = vec4(r.w, g.w, b.w, a.w);
+		cache[1][2 * p    ] = vec4(r.z, g.z, b.z, a.z);
+		cache[0][2 * p + 1] = vec4(r.x, g.x, b.x, a.x);
+		cache[1][2 * p + 1] = vec4(r.y, g.y, b.y, a.y);
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	if (pixel_coord.x < size.x && pixel_coord.y < size.y)
+	{
+		int local_column = int(gl_LocalInvocationID.x);
+		int first = int(gl_LocalInvocationID.y);
+
+		vec4 sum = vec4(0.0);
+
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * cache[local_column][first + i];
+
+		imageStore(u_output_image, pixel_coord, sum);
+	}
+}
+)";
+		struct compute_separable_gather_impl
+			: scene
+		{
+			compute_separable_gather_impl();
+
+			void on_resize(int width, int height) override;
+
+			void present() override;
+
+		private:
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::framebuffer fbo_2_;
+			gfx::texture_2d color_buffer_2_;
+
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			shared_program blur_horizontal_program_;
+			shared_program blur_vertical_program_;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_;
+
+			shared_program make_program(char const * body, pixel_format input, pixel_format output) const;
+
+			blur_traffic traffic() const;
+		};
+
+		compute_separable_gather_impl::compute_separable_gather_impl()
+			: blur_horizontal_program_{make_program(compute_separable_gather_horizontal_compute, pixel_format::rgba8, intermediate_format())}
+			, blur_vertical_program_{make_program(compute_separable_gather_vertical_compute, intermediate_format(), pixel_format::rgba8)}
+			, kernel_radius_{blur_radius()}
+			, format_{intermediate_format()}
+		{
+			color_buffer_1_.linear_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_2_.linear_filter();
+			color_buffer_2_.clamp();
+
+			color_buffer_3_.linear_filter();
+			color_buffer_3_.clamp();
+		}
+
+		shared_program compute_separable_gather_impl::make_program(char const * body, pixel_format input, pixel_format output) const
+		{
+			return services().program(util::to_string("#version 430\n\n", gaussian_kernel_source(blur_sigma(), blur_radius()), pixel_format_source(input, output), body));
+		}
+
+		void compute_separable_gather_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius() || format_ != intermediate_format())
+			{
+				kernel_radius_ = blur_radius();
+				format_ = intermediate_format();
+				blur_horizontal_program_ = make_program(compute_separable_gather_horizontal_compute, pixel_format::rgba8, format_);
+				blur_vertical_program_ = make_program(compute_separable_gather_vertical_compute, format_, pixel_format::rgba8);
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			downsampler_.resize(width, height, render_scale());
+
+			load(color_buffer_2_, format_, scaled_width(), scaled_height());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_2_.color(color_buffer_2_);
+
+			fbo_3_.color(color_buffer_3_);
+
+			fbo_1_.assert_complete();
+			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic compute_separable_gather_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// Workgroups of 64x2 pixels gather two rows (or columns) of the tile and its apron
+			int const cache = 2 * 2 * ((64 + 2 * m + 1) / 2);
+
+			blur_traffic traffic = cached_pass(scaled_width(), scaled_height(), 64, 2, cache, 4, 16, bytes, n, n);
+			traffic += cached_pass(scaled_width(), scaled_height(), 2, 64, cache, bytes, 16, 4, n, n);
+			return traffic;
+		}
+
+		void compute_separable_gather_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			fbo_2_.bind();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+				gl::Disable(gl::DEPTH_TEST);
+
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
+				int const group_size = 64;
+
+				blur_horizontal_program_.bind();
+				blur_horizontal_program_["u_input_texture"] = 0;
+
+				input.bind(0);
+				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, pixel_format_internal(format_));
+				gl::DispatchCompute((scaled_width() + group_size - 1) / group_size, (scaled_height() + 1) / 2, 1);
+
+				gl::MemoryBarrier(gl::TEXTURE_FETCH_BARRIER_BIT);
+
+				blur_vertical_program_.bind();
+				blur_vertical_program_["u_input_texture"] = 0;
+
+				color_buffer_2_.bind(0);
+				gl::BindImageTexture(1, color_buffer_3_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
+				gl::DispatchCompute((scaled_width() + 1) / 2, (scaled_height() + group_size - 1) / group_size, 1);
+
+				gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
+			}
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, render_scale() > 1 ? gl::LINEAR : gl::NEAREST);
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, "Compute separable gather", opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				// Four gathers fetch a 2x2 block, for a cache of two rows by 64 + 2M texels
+				float const fetches = 4.f * ((64 + 2 * blur_radius() + 1) / 2) / 128.f;
+				painter_.text({20.f, 120.f}, frame_text("Fetches per pixel and pass: ", fetches, " gathers (per-tap: ", 2 * blur_radius() + 1, ")"), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 140.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> compute_separable_gather()
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<compute_separable_gather_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const compute_separable_gather_registrar{{
+			.name = "compute_separable_gather",
+			.factory = compute_separable_gather,
+			.key = SDLK_o,
+			.passes = 2,
+			.scalable = true,
+			.reference_output = true,
+			.formats = true,
+			.workgroup_x = 64,
+			.workgroup_y = 2,
+			.lds_bytes = [](int radius, pixel_format){ return 4 * ((64 + 2 * radius + 1) / 2) * 16; },
+			.requirements = requires_compute,
+		}};
+
+	}
+
+}
@@ -1,4 +1,10 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
 
 #include <psemek/gfx/array.hpp>
 #include <psemek/gfx/program.hpp>
@@ -19,54 +25,15 @@ namespace compute
 	namespace
 	{
 
-		char const compute_separable_lds_horizontal_compute[] =
-R"(#version 430
+		// M, N and coeffs are prepended by make_program
 
+		char const compute_separable_lds_horizontal_compute[] =
+R"(
 const int GROUP_SIZE = 64;
 
 layout(local_size_x = 64, local_size_y = 1) in;
-layout(rgba8, binding = 0) uniform restrict readonly image2D u_input_image;
-layout(rgba8, binding = 1) uniform restrict writeonly image2D u_output_image;
-
-const int M = 16;
-const int N = 2 * M + 1;
-
-// sigma = 10
-const float coeffs[N] = float[N](
-	0.012318109844189502,
-	0.014381474814203989,
-	0.016623532195728208,
-	0.019024086115486723,
-	0.02155484948872149,
-	0.02417948052890078,
-	0.02685404941667096,
-	0.0295279624870386,
-	0.03214534135442581,
-	0.03464682117793548,
-	0.0369716985390341,
-	0.039060328279673276,
-	0.040856643282313365,
-	0.04231065439216247,
-	0.043380781642569775,
-	0.044035873841196206,
-	0.04425662519949865,
-	0.044035873841196206,
-	0.043380781642569775,
-	0.04231065439216247,
-	0.040856643282313365,
-	0.039060328279673276,
-	0.0369716985390341,
-	0.03464682117793548,
-	0.03214534135442581,
-	0.0295279624870386,
-	0.02685404941667096,
-	0.02417948052890078,
-	0.02155484948872149,
-	0.019024086115486723,
-	0.016623532195728208,
-	0.014381474814203989,
-	0.012318109844189502
-);
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
 
 const int CACHE_SIZE = GROUP_SIZE + 2 * M;
 
@@ -117,53 +84,12 @@ void main()
 )";
 
 		char const compute_separable_lds_vertical_compute[] =
-R"(#version 430
-
+R"(
 const int GROUP_SIZE = 64;
 
 layout(local_size_x = 1, local_size_y = 64) in;
-layout(rgba8, binding = 0) uniform restrict readonly image2D u_input_image;
-layout(rgba8, binding = 1) uniform restrict writeonly image2D u_output_image;
-
-const int M = 16;
-const int N = 2 * M + 1;
-
-// sigma = 10
-const float coeffs[N] = float[N](
-	0.012318109844189502,
-	0.014381474814203989,
-	0.016623532195728208,
-	0.019024086115486723,
-	0.02155484948872149,
-	0.02417948052890078,
-	0.02685404941667096,
-	0.0295279624870386,
-	0.03214534135442581,
-	0.03464682117793548,
-	0.0369716985390341,
-	0.039060328279673276,
-	0.040856643282313365,
-	0.04231065439216247,
-	0.043380781642569775,
-	0.044035873841196206,
-	0.04425662519949865,
-	0.044035873841196206,
-	0.043380781642569775,
-	0.04231065439216247,
-	0.040856643282313365,
-	0.039060328279673276,
-	0.0369716985390341,
-	0.03464682117793548,
-	0.03214534135442581,
-	0.0295279624870386,
-	0.02685404941667096,
-	0.02417948052890078,
-	0.02155484948872149,
-	0.019024086115486723,
-	0.016623532195728208,
-	0.014381474814203989,
-	0.012318109844189502
-);
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
 
 const int CACHE_SIZE = GROUP_SIZE + 2 * M;
 
@@ -235,18 +161,30 @@ void main()
 			gfx::framebuffer fbo_3_;
 			gfx::texture_2d color_buffer_3_;
 
-			gfx::program blur_horizontal_program_{compute_separable_lds_horizontal_compute};
-			gfx::program blur_vertical_program_{compute_separable_lds_vertical_compute};
+			shared_program blur_horizontal_program_;
+			shared_program blur_vertical_program_;
 
-			gfx::painter painter_;
+			gfx::painter & painter_ = services().painter;
 
 			gfx::query_pool queries_;
 
 			util::moving_average<float> frame_time_{32};
 			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_;
+
+			shared_program make_program(char const * body, pixel_format input, pixel_format output) const;
+
+			blur_traffic traffic() const;
 		};
 
 		compute_separable_lds_impl::compute_separable_lds_impl()
+			: blur_horizontal_program_{make_program(compute_separable_lds_horizontal_compute, pixel_format::rgba8, intermediate_format())}
+			, blur_vertical_program_{make_program(compute_separable_lds_vertical_compute, intermediate_format(), pixel_format::rgba8)}
+			, kernel_radius_{blur_radius()}
+			, format_{intermediate_format()}
 		{
 			color_buffer_1_.linear_filter();
 			color_buffer_1_.clamp();
@@ -258,16 +196,31 @@ void main()
 			color_buffer_3_.clamp();
 		}
 
+		shared_program compute_separable_lds_impl::make_program(char const * body, pixel_format input, pixel_format output) const
+		{
+			return services().program(util::to_string("#version 430\n\n", gaussian_kernel_source(blur_sigma(), blur_radius()), pixel_format_source(input, output), body));
+		}
+
 		void compute_separable_lds_impl::on_resize(int width, int height)
 		{
 			scene::on_resize(width, height);
 
+			if (kernel_radius_ != blur_radius() || format_ != intermediate_format())
+			{
+				kernel_radius_ = blur_radius();
+				format_ = intermediate_format();
+				blur_horizontal_program_ = make_program(compute_separable_lds_horizontal_compute, pixel_format::rgba8, format_);
+				blur_vertical_program_ = make_program(compute_separable_lds_vertical_compute, format_, pixel_format::rgba8);
+			}
+
 			color_buffer_1_.load<gfx::color_rgba>({width, height});
 			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
 
-			color_buffer_2_.load<gfx::color_rgba>({width, height});
+			downsampler_.resize(width, height, render_scale());
 
-			color_buffer_3_.load<gfx::color_rgba>({width, height});
+			load(color_buffer_2_, format_, scaled_width(), scaled_height());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
 
 			fbo_1_.color(color_buffer_1_);
 			fbo_1_.depth(depth_buffer_1_);
@@ -279,12 +232,28 @@ void main()
 			fbo_1_.assert_complete();
 			fbo_2_.assert_complete();
 			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic compute_separable_lds_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// Workgroups of 64 pixels along a row, then along a column, each caching
+			// its pixels and the apron of M on both sides
+			blur_traffic traffic = cached_pass(scaled_width(), scaled_height(), 64, 1, 64 + 2 * m, 4, 16, bytes, n, n);
+			traffic += cached_pass(scaled_width(), scaled_height(), 1, 64, 64 + 2 * m, bytes, 16, 4, n, n);
+			return traffic;
 		}
 
 		void compute_separable_lds_impl::present()
 		{
 			float const dt = clock_.restart().count();
 			frame_time_.push(dt);
+			begin_frame(dt);
 
 			fbo_1_.bind();
 			scene::draw();
@@ -292,39 +261,47 @@ void main()
 			fbo_2_.bind();
 
 			{
-				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); });
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
 
 				gl::Clear(gl::COLOR_BUFFER_BIT);
 				gl::Disable(gl::DEPTH_TEST);
 
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
 				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
 				int const group_size = 64;
 
 				blur_horizontal_program_.bind();
 
-				gl::BindImageTexture(0, color_buffer_1_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
-				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
-				gl::DispatchCompute((width() + group_size - 1) / group_size, height(), 1);
+				gl::BindImageTexture(0, input.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, pixel_format_internal(format_));
+				gl::DispatchCompute((scaled_width() + group_size - 1) / group_size, scaled_height(), 1);
 
 				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
 				blur_vertical_program_.bind();
 
-				gl::BindImageTexture(0, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+				gl::BindImageTexture(0, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, pixel_format_internal(format_));
 				gl::BindImageTexture(1, color_buffer_3_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
-				gl::DispatchCompute(width(), (height() + group_size - 1) / group_size, 1);
+				gl::DispatchCompute(scaled_width(), (scaled_height() + group_size - 1) / group_size, 1);
 
 				gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
 			}
 
 			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
 			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
-			gl::BlitFramebuffer(0, 0, width(), height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, gl::NEAREST);
+			gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, render_scale() > 1 ? gl::LINEAR : gl::NEAREST);
 
 			gfx::framebuffer::null().bind();
 
+			output_ready();
+
 			{
+				profile_scope const hud_scope{"hud text"};
+
 				gfx::painter::text_options opts;
 				opts.scale = 2.f;
 				opts.c = gfx::black;
@@ -333,15 +310,30 @@ void main()
 
 				painter_.text({20.f, 20.f}, "Compute separable LDS", opts);
 
-				painter_.text({20.f, 40.f}, util::to_string("FPS: ", 1.f / frame_time_.average()), opts);
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
 
 				if (blur_time_.count() > 0)
-					painter_.text({20.f, 60.f}, util::to_string("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
 			}
 
-			painter_.render(geom::window_camera{width(), height()}.transform());
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
 
-			queries_.poll();
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
 		}
 
 	}
@@ -357,4 +349,23 @@ void main()
 		return std::make_unique<compute_separable_lds_impl>();
 	}
 
+	namespace
+	{
+
+		variant_registrar const compute_separable_lds_registrar{{
+			.name = "compute_separable_lds",
+			.factory = compute_separable_lds,
+			.key = SDLK_7,
+			.passes = 2,
+			.scalable = true,
+			.reference_output = true,
+			.formats = true,
+			.workgroup_x = 64,
+			.workgroup_y = 1,
+			.lds_bytes = [](int radius, pixel_format){ return (64 + 2 * radius) * 16; },
+			.requirements = requires_compute,
+		}};
+
+	}
+
 }
@@ -0,0 +1,468 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+#include <stdexcept>
+
+namespace compute
+{
+
+	std::unique_ptr<scene> compute_separable_lds_channels(pixel_format format);
+
+	namespace
+	{
+
+		// M, N, coeffs, the image format qualifiers of the data format, channel_t, PIXELS and
+		// the conversion functions are prepended by make_program, see channel_source
+
+		// Converts the rendered frame to the data format, outside of the measured blur
+		char const compute_separable_lds_channels_convert_compute[] =
+R"(
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(rgba8, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
+
+	if (pixel_coord.x < size.x && pixel_coord.y < size.y)
+		imageStore(u_output_image, pixel_coord, to_image(from_color(imageLoad(u_input_image, pixel_coord))));
+}
+)";
+
+		// Expands the blurred data to RGBA for display
+		char const compute_separable_lds_channels_expand_compute[] =
+R"(
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(rgba8, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.xy);
+
+	if (pixel_coord.x < size.x && pixel_coord.y < size.y)
+		imageStore(u_output_image, pixel_coord, to_color(from_image(imageLoad(u_input_image, pixel_coord))));
+}
+)";
+
+		// Each thread blurs PIXELS pixels, so that narrower data puts more pixels into the
+		// same amount of shared memory. The pixels of a thread are GROUP_SIZE apart, which
+		// keeps both the loads and the stores of consecutive threads consecutive
+		char const compute_separable_lds_channels_horizontal_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+const int TILE_SIZE = GROUP_SIZE * PIXELS;
+
+layout(local_size_x = 64, local_size_y = 1) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+const int CACHE_SIZE = TILE_SIZE + 2 * M;
+
+shared channel_t cache[CACHE_SIZE];
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	int row = int(gl_WorkGroupID.y);
+	int tile = int(gl_WorkGroupID.x) * TILE_SIZE;
+
+	int origin = tile - M;
+
+	for (int local = int(gl_LocalInvocationID.x); local < CACHE_SIZE; local += GROUP_SIZE)
+		cache[local] = from_image(imageLoad(u_input_image, ivec2(clamp(origin + local, 0, size.x - 1), row)));
+
+	memoryBarrierShared();
+	barrier();
+
+	for (int j = 0; j < PIXELS; ++j)
+	{
+		int first = j * GROUP_SIZE + int(gl_LocalInvocationID.x);
+		if (tile + first >= size.x)
+			break;
+
+		channel_t sum = channel_t(0.0);
+
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * cache[first + i];
+
+		imageStore(u_output_image, ivec2(tile + first, row), to_image(sum));
+	}
+}
+)";
+
+		char const compute_separable_lds_channels_vertical_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+const int TILE_SIZE = GROUP_SIZE * PIXELS;
+
+layout(local_size_x = 1, local_size_y = 64) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+const int CACHE_SIZE = TILE_SIZE + 2 * M;
+
+shared channel_t cache[CACHE_SIZE];
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	int column = int(gl_WorkGroupID.x);
+	int tile = int(gl_WorkGroupID.y) * TILE_SIZE;
+
+	int origin = tile - M;
+
+	for (int local = int(gl_LocalInvocationID.y); local < CACHE_SIZE; local += GROUP_SIZE)
+		cache[local] = from_image(imageLoad(u_input_image, ivec2(column, clamp(origin + local, 0, size.y - 1))));
+
+	memoryBarrierShared();
+	barrier();
+
+	for (int j = 0; j < PIXELS; ++j)
+	{
+		int first = j * GROUP_SIZE + int(gl_LocalInvocationID.y);
+		if (tile + first >= size.y)
+			break;
+
+		channel_t sum = channel_t(0.0);
+
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * cache[first + i];
+
+		imageStore(u_output_image, ivec2(column, tile + first), to_image(sum));
+	}
+}
+)";
+
+		// Single channel data is the luminance of the frame, two channel data its red and
+		// green channels
+		std::string channel_source(pixel_format format)
+		{
+			int const channels = pixel_format_channels(format);
+
+			char const * type = (channels == 1) ? "float" : (channels == 2) ? "vec2" : "vec4";
+			char const * from_image = (channels == 1) ? "v.r" : (channels == 2) ? "v.rg" : "v";
+			char const * to_image = (channels == 1) ? "vec4(c, 0.0, 0.0, 0.0)" : (channels == 2) ? "vec4(c, 0.0, 0.0)" : "c";
+			char const * from_color = (channels == 1) ? "dot(v.rgb, vec3(0.2126, 0.7152, 0.0722))" : (channels == 2) ? "v.rg" : "v";
+			char const * to_color = (channels == 1) ? "vec4(c, c, c, 1.0)" : (channels == 2) ? "vec4(c, 0.0, 1.0)" : "c";
+
+			return util::to_string(
+				pixel_format_source(format, format),
+				"#define channel_t ", type, "\n\n",
+				"const int PIXELS = ", 4 / channels, ";\n\n",
+				"channel_t from_image(vec4 v) { return ", from_image, "; }\n",
+				"vec4 to_image(channel_t c) { return ", to_image, "; }\n",
+				"channel_t from_color(vec4 v) { return ", from_color, "; }\n",
+				"vec4 to_color(channel_t c) { return ", to_color, "; }\n");
+		}
+
+		pixel_format next_channel_format(pixel_format format)
+		{
+			switch (format)
+			{
+			case pixel_format::r8: return pixel_format::r16f;
+			case pixel_format::r16f: return pixel_format::rg8;
+			case pixel_format::rg8: return pixel_format::rgba8;
+			default: return pixel_format::r8;
+			}
+		}
+
+		struct compute_separable_lds_channels_impl
+			: scene
+		{
+			compute_separable_lds_channels_impl(pixel_format format);
+
+			void on_resize(int width, int height) override;
+
+			void on_key_down(SDL_Keycode key) override;
+
+			void present() override;
+
+		private:
+			pixel_format format_;
+
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::texture_2d data_buffer_1_;
+			gfx::texture_2d data_buffer_2_;
+			gfx::texture_2d data_buffer_3_;
+
+			gfx::framebuffer fbo_4_;
+			gfx::texture_2d color_buffer_4_;
+
+			shared_program convert_program_;
+			shared_program blur_horizontal_program_;
+			shared_program blur_vertical_program_;
+			shared_program expand_program_;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			int kernel_radius_;
+
+			shared_program make_program(char const * body) const;
+
+			blur_traffic traffic() const;
+		};
+
+		compute_separable_lds_channels_impl::compute_separable_lds_channels_impl(pixel_format format)
+			: format_(format)
+			, convert_program_{make_program(compute_separable_lds_channels_convert_compute)}
+			, blur_horizontal_program_{make_program(compute_separable_lds_channels_horizontal_compute)}
+			, blur_vertical_program_{make_program(compute_separable_lds_channels_vertical_compute)}
+			, expand_program_{make_program(compute_separable_lds_channels_expand_compute)}
+			, kernel_radius_{blur_radius()}
+		{
+			color_buffer_1_.linear_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_4_.linear_filter();
+			color_buffer_4_.clamp();
+		}
+
+		shared_program compute_separable_lds_channels_impl::make_program(char const * body) const
+		{
+			return services().program(util::to_string("#version 430\n\n", gaussian_kernel_source(blur_sigma(), blur_radius()), channel_source(format_), body));
+		}
+
+		void compute_separable_lds_channels_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius())
+			{
+				kernel_radius_ = blur_radius();
+				blur_horizontal_program_ = make_program(compute_separable_lds_channels_horizontal_compute);
+				blur_vertical_program_ = make_program(compute_separable_lds_channels_vertical_compute);
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			load(data_buffer_1_, format_, width, height);
+			load(data_buffer_2_, format_, width, height);
+			load(data_buffer_3_, format_, width, height);
+
+			color_buffer_4_.load<gfx::color_rgba>({width, height});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_4_.color(color_buffer_4_);
+
+			fbo_1_.assert_complete();
+			fbo_4_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		void compute_separable_lds_channels_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_c)
+			{
+				replace_with([format = next_channel_format(format_)]{ return compute_separable_lds_channels(format); });
+			}
+		}
+
+		blur_traffic compute_separable_lds_channels_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const tile_size = 64 * (4 / pixel_format_channels(format_));
+			int const bytes = pixel_format_bytes(format_);
+			int const element = 4 * pixel_format_channels(format_);
+
+			// Only the timed blur passes, not the conversions to and from the data format
+			blur_traffic traffic = cached_pass(width(), height(), tile_size, 1, tile_size + 2 * m, bytes, element, bytes, n, n);
+			traffic += cached_pass(width(), height(), 1, tile_size, tile_size + 2 * m, bytes, element, bytes, n, n);
+			return traffic;
+		}
+
+		void compute_separable_lds_channels_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			gfx::framebuffer::null().bind();
+
+			gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			GLenum const internal = pixel_format_internal(format_);
+
+			convert_program_.bind();
+
+			gl::BindImageTexture(0, color_buffer_1_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+			gl::BindImageTexture(1, data_buffer_1_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, internal);
+			gl::DispatchCompute((width() + 7) / 8, (height() + 7) / 8, 1);
+
+			gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			int const tile_size = 64 * (4 / pixel_format_channels(format_));
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				blur_horizontal_program_.bind();
+
+				gl::BindImageTexture(0, data_buffer_1_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, internal);
+				gl::BindImageTexture(1, data_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, internal);
+				gl::DispatchCompute((width() + tile_size - 1) / tile_size, height(), 1);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				blur_vertical_program_.bind();
+
+				gl::BindImageTexture(0, data_buffer_2_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, internal);
+				gl::BindImageTexture(1, data_buffer_3_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, internal);
+				gl::DispatchCompute(width(), (height() + tile_size - 1) / tile_size, 1);
+			}
+
+			gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			expand_program_.bind();
+
+			gl::BindImageTexture(0, data_buffer_3_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, internal);
+			gl::BindImageTexture(1, color_buffer_4_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
+			gl::DispatchCompute((width() + 7) / 8, (height() + 7) / 8, 1);
+
+			gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_4_.id());
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, 0, width(), height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, gl::NEAREST);
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, frame_text("Compute separable LDS ", pixel_format_name(format_)), opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				int const cache_bytes = (tile_size + 2 * blur_radius()) * 4 * pixel_format_channels(format_);
+				painter_.text({20.f, 80.f}, frame_text("Pixels per workgroup: ", tile_size, ", LDS: ", cache_bytes, " bytes"), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 100.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	// The format of the data being blurred: R8, R16F, RG8, or RGBA8 for comparison
+	std::unique_ptr<scene> compute_separable_lds_channels(pixel_format format)
+	{
+		if (format != pixel_format::r8 && format != pixel_format::r16f && format != pixel_format::rg8 && format != pixel_format::rgba8)
+			throw std::runtime_error(util::to_string("Unsupported data format ", pixel_format_name(format)));
+
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<compute_separable_lds_channels_impl>(format);
+	}
+
+	namespace
+	{
+
+		bool const compute_separable_lds_channels_registered = []
+		{
+			struct channels_variant
+			{
+				char const * suffix;
+				pixel_format format;
+			};
+
+			channels_variant const list[] =
+			{
+				{"r8", pixel_format::r8},
+				{"r16f", pixel_format::r16f},
+				{"rg8", pixel_format::rg8},
+				{"rgba8", pixel_format::rgba8},
+			};
+
+			for (auto const & [suffix, format] : list)
+			{
+				int const channels = pixel_format_channels(format);
+
+				register_variant({
+					.name = util::to_string("compute_separable_lds_", suffix),
+					.factory = [format = format]{ return compute_separable_lds_channels(format); },
+					.key = (format == pixel_format::r8) ? SDLK_s : SDLK_UNKNOWN,
+					.passes = 2,
+					.workgroup_x = 64,
+					.workgroup_y = 1,
+					.lds_bytes = [channels](int radius, pixel_format){ return (64 * (4 / channels) + 2 * radius) * 4 * channels; },
+					.requirements = requires_compute,
+					.baseline = (format == pixel_format::rgba8) ? std::string{} : std::string{"compute_separable_lds_rgba8"},
+				});
+			}
+
+			return true;
+		}();
+
+	}
+
+}
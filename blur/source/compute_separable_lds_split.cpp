@@ -0,0 +1,488 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/border.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+#include <algorithm>
+
+namespace compute
+{
+
+	std::unique_ptr<scene> compute_separable_lds_split(border_mode border, bool split);
+
+	namespace
+	{
+
+		// M, N, coeffs, the border addressing functions and, for the interior kernel,
+		// INTERIOR are prepended by make_program
+		//
+		// The border mode is applied when filling the cache, so the taps never need clamping.
+		// Interior workgroups, whose cache lies entirely inside of the image, additionally
+		// skip the border addressing and the bounds check. The workgroups are dispatched in
+		// ranges starting at u_group_offset
+
+		char const compute_separable_lds_split_horizontal_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+layout(local_size_x = 64, local_size_y = 1) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+uniform int u_group_offset;
+
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
+
+const int LOAD = (CACHE_SIZE + (GROUP_SIZE - 1)) / GROUP_SIZE;
+
+shared vec4 cache[CACHE_SIZE];
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	int group = int(gl_WorkGroupID.x) + u_group_offset;
+	ivec2 pixel_coord = ivec2(group * GROUP_SIZE + int(gl_LocalInvocationID.x), gl_GlobalInvocationID.y);
+
+	int origin = group * GROUP_SIZE - M;
+
+	for (int i = 0; i < LOAD; ++i)
+	{
+		int local = int(gl_LocalInvocationID.x) * LOAD + i;
+		if (local < CACHE_SIZE)
+		{
+			int pc = origin + local;
+#ifdef INTERIOR
+			cache[local] = imageLoad(u_input_image, ivec2(pc, pixel_coord.y));
+#else
+			cache[local] = border_weight(pc, size.x) * imageLoad(u_input_image, ivec2(border_index(pc, size.x), pixel_coord.y));
+#endif
+		}
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+#ifndef INTERIOR
+	if (pixel_coord.x >= size.x)
+		return;
+#endif
+
+	int first = int(gl_LocalInvocationID.x);
+
+	vec4 sum = vec4(0.0);
+
+	for (int i = 0; i < N; ++i)
+		sum += coeffs[i] * cache[first + i];
+
+	imageStore(u_output_image, pixel_coord, sum);
+}
+)";
+
+		char const compute_separable_lds_split_vertical_compute[] =
+R"(
+const int GROUP_SIZE = 64;
+
+layout(local_size_x = 1, local_size_y = 64) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+uniform int u_group_offset;
+
+const int CACHE_SIZE = GROUP_SIZE + 2 * M;
+
+const int LOAD = (CACHE_SIZE + (GROUP_SIZE - 1)) / GROUP_SIZE;
+
+shared vec4 cache[CACHE_SIZE];
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	int group = int(gl_WorkGroupID.y) + u_group_offset;
+	ivec2 pixel_coord = ivec2(gl_GlobalInvocationID.x, group * GROUP_SIZE + int(gl_LocalInvocationID.y));
+
+	int origin = group * GROUP_SIZE - M;
+
+	for (int i = 0; i < LOAD; ++i)
+	{
+		int local = int(gl_LocalInvocationID.y) * LOAD + i;
+		if (local < CACHE_SIZE)
+		{
+			int pc = origin + local;
+#ifdef INTERIOR
+			cache[local] = imageLoad(u_input_image, ivec2(pixel_coord.x, pc));
+#else
+			cache[local] = border_weight(pc, size.y) * imageLoad(u_input_image, ivec2(pixel_coord.x, border_index(pc, size.y)));
+#endif
+		}
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+#ifndef INTERIOR
+	if (pixel_coord.y >= size.y)
+		return;
+#endif
+
+	int first = int(gl_LocalInvocationID.y);
+
+	vec4 sum = vec4(0.0);
+
+	for (int i = 0; i < N; ++i)
+		sum += coeffs[i] * cache[first + i];
+
+	imageStore(u_output_image, pixel_coord, sum);
+}
+)";
+
+		// Range [begin, end) of the workgroups along a dimension of the given size whose
+		// cache doesn't cross the image border
+		std::pair<int, int> interior_groups(int size, int radius, int group_size)
+		{
+			int const begin = (radius + group_size - 1) / group_size;
+			int const end = std::max(begin, (size - radius) / group_size);
+			return {begin, end};
+		}
+
+		struct compute_separable_lds_split_impl
+			: scene
+		{
+			compute_separable_lds_split_impl(border_mode border, bool split);
+
+			void on_resize(int width, int height) override;
+
+			void on_key_down(SDL_Keycode key) override;
+
+			void present() override;
+
+		private:
+			border_mode border_;
+			bool split_;
+
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::framebuffer fbo_2_;
+			gfx::texture_2d color_buffer_2_;
+
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			shared_program blur_horizontal_program_;
+			shared_program blur_vertical_program_;
+			shared_program blur_horizontal_interior_program_;
+			shared_program blur_vertical_interior_program_;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_;
+
+			shared_program make_program(char const * body, pixel_format input, pixel_format output, bool interior) const;
+
+			void make_programs();
+
+			// Dispatches the groups of the pass along the blurred dimension, the interior
+			// ones with the interior program if the dispatch is split
+			void dispatch(shared_program border_program, shared_program interior_program, bool horizontal);
+
+			blur_traffic traffic() const;
+		};
+
+		compute_separable_lds_split_impl::compute_separable_lds_split_impl(border_mode border, bool split)
+			: border_(border)
+			, split_(split)
+			, blur_horizontal_program_{make_program(compute_separable_lds_split_horizontal_compute, pixel_format::rgba8, intermediate_format(), false)}
+			, blur_vertical_program_{make_program(compute_separable_lds_split_vertical_compute, intermediate_format(), pixel_format::rgba8, false)}
+			, blur_horizontal_interior_program_{make_program(compute_separable_lds_split_horizontal_compute, pixel_format::rgba8, intermediate_format(), true)}
+			, blur_vertical_interior_program_{make_program(compute_separable_lds_split_vertical_compute, intermediate_format(), pixel_format::rgba8, true)}
+			, kernel_radius_{blur_radius()}
+			, format_{intermediate_format()}
+		{
+			color_buffer_1_.linear_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_2_.linear_filter();
+			color_buffer_2_.clamp();
+
+			color_buffer_3_.linear_filter();
+			color_buffer_3_.clamp();
+		}
+
+		shared_program compute_separable_lds_split_impl::make_program(char const * body, pixel_format input, pixel_format output, bool interior) const
+		{
+			return services().program(util::to_string("#version 430\n\n", interior ? "#define INTERIOR\n\n" : "", gaussian_kernel_source(blur_sigma(), blur_radius()), border_source(border_), "\n", pixel_format_source(input, output), body));
+		}
+
+		void compute_separable_lds_split_impl::make_programs()
+		{
+			blur_horizontal_program_ = make_program(compute_separable_lds_split_horizontal_compute, pixel_format::rgba8, format_, false);
+			blur_vertical_program_ = make_program(compute_separable_lds_split_vertical_compute, format_, pixel_format::rgba8, false);
+			blur_horizontal_interior_program_ = make_program(compute_separable_lds_split_horizontal_compute, pixel_format::rgba8, format_, true);
+			blur_vertical_interior_program_ = make_program(compute_separable_lds_split_vertical_compute, format_, pixel_format::rgba8, true);
+		}
+
+		void compute_separable_lds_split_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius() || format_ != intermediate_format())
+			{
+				kernel_radius_ = blur_radius();
+				format_ = intermediate_format();
+				make_programs();
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			downsampler_.resize(width, height, render_scale());
+
+			load(color_buffer_2_, format_, scaled_width(), scaled_height());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_2_.color(color_buffer_2_);
+
+			fbo_3_.color(color_buffer_3_);
+
+			fbo_1_.assert_complete();
+			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		void compute_separable_lds_split_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_m)
+			{
+				replace_with([border = static_cast<border_mode>((static_cast<int>(border_) + 1) % border_mode_count), split = split_]{ return compute_separable_lds_split(border, split); });
+			}
+			else if (key == SDLK_n)
+			{
+				replace_with([border = border_, split = !split_]{ return compute_separable_lds_split(border, split); });
+			}
+		}
+
+		void compute_separable_lds_split_impl::dispatch(shared_program border_program, shared_program interior_program, bool horizontal)
+		{
+			int const group_size = 64;
+
+			int const size = horizontal ? scaled_width() : scaled_height();
+			int const lines = horizontal ? scaled_height() : scaled_width();
+			int const groups = (size + group_size - 1) / group_size;
+
+			auto run = [&](shared_program program, int begin, int end)
+			{
+				if (begin >= end)
+					return;
+
+				program.bind();
+				program["u_group_offset"] = begin;
+
+				if (horizontal)
+					gl::DispatchCompute(end - begin, lines, 1);
+				else
+					gl::DispatchCompute(lines, end - begin, 1);
+			};
+
+			if (!split_)
+			{
+				run(border_program, 0, groups);
+				return;
+			}
+
+			auto const interior = interior_groups(size, blur_radius(), group_size);
+
+			run(border_program, 0, interior.first);
+			run(interior_program, interior.first, interior.second);
+			run(border_program, interior.second, groups);
+		}
+
+		blur_traffic compute_separable_lds_split_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// Workgroups of 64 pixels along a row, then along a column, each caching
+			// its pixels and the apron of M on both sides
+			blur_traffic traffic = cached_pass(scaled_width(), scaled_height(), 64, 1, 64 + 2 * m, 4, 16, bytes, n, n);
+			traffic += cached_pass(scaled_width(), scaled_height(), 1, 64, 64 + 2 * m, bytes, 16, 4, n, n);
+			return traffic;
+		}
+
+		void compute_separable_lds_split_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			fbo_2_.bind();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+				gl::Disable(gl::DEPTH_TEST);
+
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				gl::BindImageTexture(0, input.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, pixel_format_internal(format_));
+				dispatch(blur_horizontal_program_, blur_horizontal_interior_program_, true);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				gl::BindImageTexture(0, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, pixel_format_internal(format_));
+				gl::BindImageTexture(1, color_buffer_3_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
+				dispatch(blur_vertical_program_, blur_vertical_interior_program_, false);
+
+				gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
+			}
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, render_scale() > 1 ? gl::LINEAR : gl::NEAREST);
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, frame_text("Compute separable LDS split (", border_mode_name(border_), " border)"), opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				if (split_)
+				{
+					auto const columns = interior_groups(scaled_width(), blur_radius(), 64);
+					auto const rows = interior_groups(scaled_height(), blur_radius(), 64);
+					painter_.text({20.f, 120.f}, frame_text("Interior groups: ", columns.second - columns.first, " of ", (scaled_width() + 63) / 64, " columns, ",
+						rows.second - rows.first, " of ", (scaled_height() + 63) / 64, " rows"), opts);
+				}
+				else
+					painter_.text({20.f, 120.f}, "Interior groups: not split", opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 140.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> compute_separable_lds_split(border_mode border, bool split)
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<compute_separable_lds_split_impl>(border, split);
+	}
+
+	namespace
+	{
+
+		// Clamping split and unsplit variants are compared against the plain shared memory
+		// variant, which clamps too. The other border modes only exist here, so split is
+		// compared against unsplit, at the default intermediate format only
+		bool const compute_separable_lds_split_registered = []
+		{
+			for (int mode = 0; mode < border_mode_count; ++mode)
+			{
+				auto const border = static_cast<border_mode>(mode);
+				bool const clamp = (border == border_mode::clamp);
+				auto const suffix = util::to_string(border_mode_name(border));
+				auto const unsplit_name = util::to_string("compute_separable_lds_unsplit_", suffix);
+
+				for (bool split : {true, false})
+					register_variant({
+						.name = split ? util::to_string("compute_separable_lds_split_", suffix) : unsplit_name,
+						.factory = [border, split]{ return compute_separable_lds_split(border, split); },
+						.key = (clamp && split) ? SDLK_a : SDLK_UNKNOWN,
+						.passes = 2,
+						.scalable = true,
+						.reference_output = clamp,
+						.formats = clamp,
+						.workgroup_x = 64,
+						.workgroup_y = 1,
+						.lds_bytes = [](int radius, pixel_format){ return (64 + 2 * radius) * 16; },
+						.requirements = requires_compute,
+						.baseline = clamp ? std::string{"compute_separable_lds"} : split ? unsplit_name : std::string{},
+					});
+			}
+
+			return true;
+		}();
+
+	}
+
+}
@@ -0,0 +1,326 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		// Side of the square block a workgroup transposes, and rows it blurs at a time
+		int const tile_size = 32;
+		int const tile_rows = 8;
+
+		// TILE, ROWS, M, N and coeffs are prepended by make_program
+
+		// Blurs rows and stores the result transposed. Running it twice blurs both
+		// directions with row reads only, and the second pass restores the orientation.
+		// A workgroup blurs a TILE x TILE block a few rows at a time into a padded shared
+		// memory tile, then writes the block transposed, so that both the reads and the
+		// writes of global memory run along rows
+		char const compute_separable_lds_transposed_compute[] =
+R"(
+layout(local_size_x = TILE, local_size_y = ROWS) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+const int CACHE_WIDTH = TILE + 2 * M;
+
+// ROWS input rows with their apron, clamped to the image when loaded
+shared vec4 rows[ROWS * CACHE_WIDTH];
+
+// The blurred block, padded by a column so that reading it transposed
+// doesn't hit the same shared memory bank from every invocation
+shared vec4 tile[TILE * (TILE + 1)];
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE;
+
+	int lx = int(gl_LocalInvocationID.x);
+	int ly = int(gl_LocalInvocationID.y);
+	int index = ly * TILE + lx;
+
+	for (int block = 0; block < TILE; block += ROWS)
+	{
+		for (int i = index; i < ROWS * CACHE_WIDTH; i += TILE * ROWS)
+		{
+			int row = i / CACHE_WIDTH;
+			int column = i - row * CACHE_WIDTH;
+			ivec2 pc = ivec2(origin.x - M + column, origin.y + block + row);
+			rows[i] = imageLoad(u_input_image, clamp(pc, ivec2(0), size - 1));
+		}
+
+		memoryBarrierShared();
+		barrier();
+
+		vec4 sum = vec4(0.0);
+		for (int i = 0; i < N; ++i)
+			sum += coeffs[i] * rows[ly * CACHE_WIDTH + lx + i];
+
+		tile[(block + ly) * (TILE + 1) + lx] = sum;
+
+		memoryBarrierShared();
+		barrier();
+	}
+
+	// Invocation lx writes input row origin.y + lx, which is a column of the output
+	for (int column = ly; column < TILE; column += ROWS)
+	{
+		ivec2 pc = ivec2(origin.y + lx, origin.x + column);
+		if (pc.x < size.y && pc.y < size.x)
+			imageStore(u_output_image, pc, tile[lx * (TILE + 1) + column]);
+	}
+}
+)";
+
+		struct compute_separable_lds_transposed_impl
+			: scene
+		{
+			compute_separable_lds_transposed_impl();
+
+			void on_resize(int width, int height) override;
+
+			void present() override;
+
+		private:
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::framebuffer fbo_2_;
+			gfx::texture_2d color_buffer_2_;
+
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			shared_program blur_first_program_;
+			shared_program blur_second_program_;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_;
+
+			shared_program make_program(char const * body, pixel_format input, pixel_format output) const;
+
+			blur_traffic traffic() const;
+		};
+
+		compute_separable_lds_transposed_impl::compute_separable_lds_transposed_impl()
+			: blur_first_program_{make_program(compute_separable_lds_transposed_compute, pixel_format::rgba8, intermediate_format())}
+			, blur_second_program_{make_program(compute_separable_lds_transposed_compute, intermediate_format(), pixel_format::rgba8)}
+			, kernel_radius_{blur_radius()}
+			, format_{intermediate_format()}
+		{
+			color_buffer_1_.linear_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_2_.linear_filter();
+			color_buffer_2_.clamp();
+
+			color_buffer_3_.linear_filter();
+			color_buffer_3_.clamp();
+		}
+
+		shared_program compute_separable_lds_transposed_impl::make_program(char const * body, pixel_format input, pixel_format output) const
+		{
+			return services().program(util::to_string("#version 430\n\n#define TILE ", tile_size, "\n#define ROWS ", tile_rows, "\n", gaussian_kernel_source(blur_sigma(), blur_radius()), pixel_format_source(input, output), body));
+		}
+
+		void compute_separable_lds_transposed_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius() || format_ != intermediate_format())
+			{
+				kernel_radius_ = blur_radius();
+				format_ = intermediate_format();
+				blur_first_program_ = make_program(compute_separable_lds_transposed_compute, pixel_format::rgba8, format_);
+				blur_second_program_ = make_program(compute_separable_lds_transposed_compute, format_, pixel_format::rgba8);
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			downsampler_.resize(width, height, render_scale());
+
+			// Holds the transposed horizontal pass result
+			load(color_buffer_2_, format_, scaled_height(), scaled_width());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_2_.color(color_buffer_2_);
+
+			fbo_3_.color(color_buffer_3_);
+
+			fbo_1_.assert_complete();
+			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic compute_separable_lds_transposed_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// Both passes run along rows, the second one over the transposed intermediate. The
+			// apron is loaded for every row of a tile, and every pixel goes through the
+			// transposition tile once more
+			int const cache = tile_size * (tile_size + 2 * m) + tile_size * tile_size;
+			blur_traffic traffic = cached_pass(scaled_width(), scaled_height(), tile_size, tile_size, cache, 4, 16, bytes, n + 1, n);
+			traffic += cached_pass(scaled_height(), scaled_width(), tile_size, tile_size, cache, bytes, 16, 4, n + 1, n);
+			return traffic;
+		}
+
+		void compute_separable_lds_transposed_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			fbo_2_.bind();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+				gl::Disable(gl::DEPTH_TEST);
+
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				blur_first_program_.bind();
+
+				gl::BindImageTexture(0, input.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, pixel_format_internal(format_));
+				gl::DispatchCompute((scaled_width() + tile_size - 1) / tile_size, (scaled_height() + tile_size - 1) / tile_size, 1);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				blur_second_program_.bind();
+
+				gl::BindImageTexture(0, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, pixel_format_internal(format_));
+				gl::BindImageTexture(1, color_buffer_3_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
+				gl::DispatchCompute((scaled_height() + tile_size - 1) / tile_size, (scaled_width() + tile_size - 1) / tile_size, 1);
+
+				gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
+			}
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, render_scale() > 1 ? gl::LINEAR : gl::NEAREST);
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, "Compute separable LDS, transposed", opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> compute_separable_lds_transposed()
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<compute_separable_lds_transposed_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const compute_separable_lds_transposed_registrar{{
+			.name = "compute_separable_lds_transposed",
+			.factory = compute_separable_lds_transposed,
+			.key = SDLK_u,
+			.passes = 2,
+			.scalable = true,
+			.reference_output = true,
+			.formats = true,
+			.workgroup_x = tile_size,
+			.workgroup_y = tile_rows,
+			.lds_bytes = [](int radius, pixel_format){ return (tile_rows * (tile_size + 2 * radius) + tile_size * (tile_size + 1)) * 16; },
+			.requirements = requires_compute,
+		}};
+
+	}
+
+}
@@ -1,4 +1,10 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/lds.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
 
 #include <psemek/gfx/array.hpp>
 #include <psemek/gfx/program.hpp>
@@ -16,61 +22,24 @@
 namespace compute
 {
 
+	std::unique_ptr<scene> compute_separable_single_lds(lds_layout layout, pixel_format storage);
+
 	namespace
 	{
 
-		char const compute_separable_single_lds_compute[] =
-R"(#version 430
+		// M, N and coeffs, and the cache layout and packing macros are prepended by make_program
 
+		char const compute_separable_single_lds_compute[] =
+R"(
 const int GROUP_SIZE = 16;
 
 layout(local_size_x = 16, local_size_y = 16) in;
 layout(rgba8, binding = 0) uniform restrict readonly image2D u_input_image;
 layout(rgba8, binding = 1) uniform restrict writeonly image2D u_output_image;
 
-const int M = 16;
-const int N = 2 * M + 1;
-
-// sigma = 10
-const float coeffs[N] = float[N](
-	0.012318109844189502,
-	0.014381474814203989,
-	0.016623532195728208,
-	0.019024086115486723,
-	0.02155484948872149,
-	0.02417948052890078,
-	0.02685404941667096,
-	0.0295279624870386,
-	0.03214534135442581,
-	0.03464682117793548,
-	0.0369716985390341,
-	0.039060328279673276,
-	0.040856643282313365,
-	0.04231065439216247,
-	0.043380781642569775,
-	0.044035873841196206,
-	0.04425662519949865,
-	0.044035873841196206,
-	0.043380781642569775,
-	0.04231065439216247,
-	0.040856643282313365,
-	0.039060328279673276,
-	0.0369716985390341,
-	0.03464682117793548,
-	0.03214534135442581,
-	0.0295279624870386,
-	0.02685404941667096,
-	0.02417948052890078,
-	0.02155484948872149,
-	0.019024086115486723,
-	0.016623532195728208,
-	0.014381474814203989,
-	0.012318109844189502
-);
-
 const int CACHE_SIZE = GROUP_SIZE + 2 * M;
 
-shared vec4 cache[CACHE_SIZE][CACHE_SIZE];
+shared lds_t cache[CACHE_SIZE * CACHE_STRIDE];
 
 const int LOAD = (CACHE_SIZE + GROUP_SIZE - 1) / GROUP_SIZE;
 
@@ -91,7 +60,7 @@ void main()
 
 			if (pc.x >= 0 && pc.y >= 0 && pc.x < size.x && pc.y < size.y && local.x < CACHE_SIZE && local.y < CACHE_SIZE)
 			{
-				cache[local.x][local.y] = imageLoad(u_input_image, pc);
+				cache_store(local, imageLoad(u_input_image, pc));
 			}
 		}
 	}
@@ -119,13 +88,13 @@ void main()
 
 				ivec2 local = pc - workgroup_origin;
 
-				sum += coeffs[i] * cache[local.x][local.y];
+				sum += coeffs[i] * cache_load(local);
 			}
 
 			memoryBarrierShared();
 			barrier();
 
-			cache[local.x][local.y] = sum;
+			cache_store(local, sum);
 		}
 	}
 
@@ -147,7 +116,7 @@ void main()
 
 			ivec2 local = pc - workgroup_origin;
 
-			sum += coeffs[i] * cache[local.x][local.y];
+			sum += coeffs[i] * cache_load(local);
 		}
 
 		imageStore(u_output_image, pixel_coord, sum);
@@ -158,10 +127,12 @@ void main()
 		struct compute_separable_single_lds_impl
 			: scene
 		{
-			compute_separable_single_lds_impl();
+			compute_separable_single_lds_impl(lds_layout layout, pixel_format storage);
 
 			void on_resize(int width, int height) override;
 
+			void on_key_down(SDL_Keycode key) override;
+
 			void present() override;
 
 		private:
@@ -174,17 +145,34 @@ void main()
 			gfx::framebuffer fbo_2_;
 			gfx::texture_2d color_buffer_2_;
 
-			gfx::program blur_program_{compute_separable_single_lds_compute};
+			lds_layout layout_;
+			pixel_format storage_;
+
+			shared_program blur_program_;
 
-			gfx::painter painter_;
+			gfx::painter & painter_ = services().painter;
 
 			gfx::query_pool queries_;
 
 			util::moving_average<float> frame_time_{32};
 			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+
+			shared_program make_program(char const * body) const;
+
+			// The tile covers the workgroup and an apron of the kernel radius
+			int lds_bytes() const;
+
+			blur_traffic traffic() const;
 		};
 
-		compute_separable_single_lds_impl::compute_separable_single_lds_impl()
+		compute_separable_single_lds_impl::compute_separable_single_lds_impl(lds_layout layout, pixel_format storage)
+			: layout_{layout}
+			, storage_{storage}
+			, blur_program_{make_program(compute_separable_single_lds_compute)}
+			, kernel_radius_{blur_radius()}
 		{
 			color_buffer_1_.linear_filter();
 			color_buffer_1_.clamp();
@@ -193,14 +181,48 @@ void main()
 			color_buffer_2_.clamp();
 		}
 
+		shared_program compute_separable_single_lds_impl::make_program(char const * body) const
+		{
+			check_lds_size(lds_bytes());
+
+			return services().program(util::to_string("#version 430\n\n", gaussian_kernel_source(blur_sigma(), blur_radius()), lds_cache_source(layout_, storage_), body));
+		}
+
+		int compute_separable_single_lds_impl::lds_bytes() const
+		{
+			return lds_cache_bytes(layout_, storage_, 16 + 2 * blur_radius());
+		}
+
+		void compute_separable_single_lds_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_l)
+			{
+				replace_with([layout = static_cast<lds_layout>((static_cast<int>(layout_) + 1) % lds_layout_count), storage = storage_]{ return compute_separable_single_lds(layout, storage); });
+			}
+			else if (key == SDLK_p)
+			{
+				replace_with([layout = layout_, storage = next_lds_storage(storage_)]{ return compute_separable_single_lds(layout, storage); });
+			}
+		}
+
 		void compute_separable_single_lds_impl::on_resize(int width, int height)
 		{
 			scene::on_resize(width, height);
 
+			if (kernel_radius_ != blur_radius())
+			{
+				kernel_radius_ = blur_radius();
+				blur_program_ = make_program(compute_separable_single_lds_compute);
+			}
+
 			color_buffer_1_.load<gfx::color_rgba>({width, height});
 			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
 
-			color_buffer_2_.load<gfx::color_rgba>({width, height});
+			downsampler_.resize(width, height, render_scale());
+
+			color_buffer_2_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
 
 			fbo_1_.color(color_buffer_1_);
 			fbo_1_.depth(depth_buffer_1_);
@@ -209,12 +231,31 @@ void main()
 
 			fbo_1_.assert_complete();
 			fbo_2_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic compute_separable_single_lds_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const cache_size = 16 + 2 * m;
+			int const element = pixel_format_bytes(storage_);
+
+			// The horizontal pass also blurs the apron rows: 16 x (16 + 2M) results per
+			// 16x16 workgroup, written back to the cache
+			double const rows = cache_size / 16.0;
+
+			blur_traffic traffic = cached_pass(scaled_width(), scaled_height(), 16, 16, cache_size * cache_size, 4, element, 4, n * (rows + 1.0), n * (rows + 1.0));
+			traffic.lds_written += double(scaled_width()) * scaled_height() * rows * element;
+			return traffic;
 		}
 
 		void compute_separable_single_lds_impl::present()
 		{
 			float const dt = clock_.restart().count();
 			frame_time_.push(dt);
+			begin_frame(dt);
 
 			fbo_1_.bind();
 			scene::draw();
@@ -222,52 +263,74 @@ void main()
 			fbo_2_.bind();
 
 			{
-				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); });
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
 
 				gl::Clear(gl::COLOR_BUFFER_BIT);
 				gl::Disable(gl::DEPTH_TEST);
 
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
 				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
 				int const group_size = 16;
 
 				blur_program_.bind();
-				gl::BindImageTexture(0, color_buffer_1_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+				gl::BindImageTexture(0, input.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
 				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
-				gl::DispatchCompute((width() + group_size - 1) / group_size, (height() + group_size - 1) / group_size, 1);
+				gl::DispatchCompute((scaled_width() + group_size - 1) / group_size, (scaled_height() + group_size - 1) / group_size, 1);
 
 				gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
 			}
 
 			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_2_.id());
 			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
-			gl::BlitFramebuffer(0, 0, width(), height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, gl::NEAREST);
+			gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, render_scale() > 1 ? gl::LINEAR : gl::NEAREST);
 
 			gfx::framebuffer::null().bind();
 
+			output_ready();
+
 			{
+				profile_scope const hud_scope{"hud text"};
+
 				gfx::painter::text_options opts;
 				opts.scale = 2.f;
 				opts.c = gfx::black;
 				opts.x = gfx::painter::x_align::left;
 				opts.y = gfx::painter::y_align::top;
 
-				painter_.text({20.f, 20.f}, "Compute separable single-pass LDS", opts);
+				painter_.text({20.f, 20.f}, frame_text("Compute separable single-pass LDS (", lds_layout_name(layout_), ", ", pixel_format_name(storage_), ")"), opts);
 
-				painter_.text({20.f, 40.f}, util::to_string("FPS: ", 1.f / frame_time_.average()), opts);
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
 
 				if (blur_time_.count() > 0)
-					painter_.text({20.f, 60.f}, util::to_string("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				painter_.text({20.f, 100.f}, frame_text("LDS: ", lds_bytes(), " bytes per workgroup"), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
 			}
 
-			painter_.render(geom::window_camera{width(), height()}.transform());
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
 
-			queries_.poll();
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
 		}
 
 	}
 
-	std::unique_ptr<scene> compute_separable_single_lds()
+	std::unique_ptr<scene> compute_separable_single_lds(lds_layout layout, pixel_format storage)
 	{
 		if (!gl::sys::ext_ARB_compute_shader())
 			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
@@ -275,7 +338,47 @@ void main()
 		if (!gl::sys::ext_ARB_shader_image_load_store())
 			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
 
-		return std::make_unique<compute_separable_single_lds_impl>();
+		return std::make_unique<compute_separable_single_lds_impl>(layout, storage);
+	}
+
+	namespace
+	{
+
+		struct single_lds_variant
+		{
+			char const * suffix;
+			lds_layout layout;
+			pixel_format storage;
+			SDL_Keycode key;
+		};
+
+		bool const compute_separable_single_lds_registered = []
+		{
+			single_lds_variant const list[] =
+			{
+				{"", lds_layout::column, pixel_format::rgba32f, SDLK_8},
+				{"_column_padded", lds_layout::column_padded, pixel_format::rgba32f, SDLK_UNKNOWN},
+				{"_row", lds_layout::row, pixel_format::rgba32f, SDLK_UNKNOWN},
+				{"_row_half", lds_layout::row, pixel_format::rgba16f, SDLK_UNKNOWN},
+				{"_row_rgba8", lds_layout::row, pixel_format::rgba8, SDLK_UNKNOWN},
+			};
+
+			for (auto const & v : list)
+				register_variant({
+					.name = util::to_string("compute_separable_single_lds", v.suffix),
+					.factory = [v]{ return compute_separable_single_lds(v.layout, v.storage); },
+					.key = v.key,
+					.scalable = true,
+					.reference_output = true,
+					.workgroup_x = 16,
+					.workgroup_y = 16,
+					.lds_bytes = [v](int radius, pixel_format){ return lds_cache_bytes(v.layout, v.storage, 16 + 2 * radius); },
+					.requirements = requires_compute,
+				});
+
+			return true;
+		}();
+
 	}
 
 }
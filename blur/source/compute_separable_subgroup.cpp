@@ -0,0 +1,357 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		// Outputs per workgroup, the subgroups of a workgroup tile it
+		int const group_size = 64;
+
+		// A strip needs 2 * M extra samples, two per lane
+		int max_subgroup_radius()
+		{
+			GLint subgroup_size = 0;
+			gl::GetIntegerv(gl::SUBGROUP_SIZE_KHR, &subgroup_size);
+			return subgroup_size / 2;
+		}
+
+		// GROUP_SIZE, M, N and coeffs are prepended by make_program
+
+		char const compute_separable_subgroup_horizontal_compute[] =
+R"(
+layout(local_size_x = GROUP_SIZE, local_size_y = 1) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	int row = int(gl_GlobalInvocationID.y);
+
+	int lane = int(gl_SubgroupInvocationID);
+	int subgroup_size = int(gl_SubgroupSize);
+
+	// Each subgroup produces a strip of gl_SubgroupSize consecutive outputs
+	int origin = int(gl_WorkGroupID.x) * GROUP_SIZE + int(gl_SubgroupID) * subgroup_size;
+
+	// The strip needs gl_SubgroupSize + 2 * M samples, so every lane holds two of them
+	// (this requires gl_SubgroupSize >= 2 * M, which is checked when the program is built)
+	int first = origin - M + lane;
+	vec4 low = imageLoad(u_input_image, ivec2(clamp(first, 0, size.x - 1), row));
+	vec4 high = imageLoad(u_input_image, ivec2(clamp(first + subgroup_size, 0, size.x - 1), row));
+
+	vec4 sum = vec4(0.0);
+
+	for (int i = 0; i < N; ++i)
+	{
+		int index = lane + i;
+
+		// Every lane has to take part in both shuffles, the right one is selected afterwards
+		vec4 from_low = subgroupShuffle(low, uint(min(index, subgroup_size - 1)));
+		vec4 from_high = subgroupShuffle(high, uint(max(index - subgroup_size, 0)));
+
+		sum += coeffs[i] * (index < subgroup_size ? from_low : from_high);
+	}
+
+	int pc = origin + lane;
+	if (pc < size.x && row < size.y)
+		imageStore(u_output_image, ivec2(pc, row), sum);
+}
+)";
+
+		char const compute_separable_subgroup_vertical_compute[] =
+R"(
+layout(local_size_x = 1, local_size_y = GROUP_SIZE) in;
+layout(INPUT_FORMAT, binding = 0) uniform restrict readonly image2D u_input_image;
+layout(OUTPUT_FORMAT, binding = 1) uniform restrict writeonly image2D u_output_image;
+
+void main()
+{
+	ivec2 size = imageSize(u_input_image);
+	int row = int(gl_GlobalInvocationID.x);
+
+	int lane = int(gl_SubgroupInvocationID);
+	int subgroup_size = int(gl_SubgroupSize);
+
+	// Each subgroup produces a strip of gl_SubgroupSize consecutive outputs
+	int origin = int(gl_WorkGroupID.y) * GROUP_SIZE + int(gl_SubgroupID) * subgroup_size;
+
+	// The strip needs gl_SubgroupSize + 2 * M samples, so every lane holds two of them
+	// (this requires gl_SubgroupSize >= 2 * M, which is checked when the program is built)
+	int first = origin - M + lane;
+	vec4 low = imageLoad(u_input_image, ivec2(row, clamp(first, 0, size.y - 1)));
+	vec4 high = imageLoad(u_input_image, ivec2(row, clamp(first + subgroup_size, 0, size.y - 1)));
+
+	vec4 sum = vec4(0.0);
+
+	for (int i = 0; i < N; ++i)
+	{
+		int index = lane + i;
+
+		// Every lane has to take part in both shuffles, the right one is selected afterwards
+		vec4 from_low = subgroupShuffle(low, uint(min(index, subgroup_size - 1)));
+		vec4 from_high = subgroupShuffle(high, uint(max(index - subgroup_size, 0)));
+
+		sum += coeffs[i] * (index < subgroup_size ? from_low : from_high);
+	}
+
+	int pc = origin + lane;
+	if (pc < size.y && row < size.x)
+		imageStore(u_output_image, ivec2(row, pc), sum);
+}
+)";
+
+		struct compute_separable_subgroup_impl
+			: scene
+		{
+			compute_separable_subgroup_impl();
+
+			void on_resize(int width, int height) override;
+
+			void present() override;
+
+		private:
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::framebuffer fbo_2_;
+			gfx::texture_2d color_buffer_2_;
+
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			shared_program blur_horizontal_program_;
+			shared_program blur_vertical_program_;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_;
+
+			shared_program make_program(char const * body, pixel_format input, pixel_format output) const;
+
+			blur_traffic traffic() const;
+		};
+
+		compute_separable_subgroup_impl::compute_separable_subgroup_impl()
+			: blur_horizontal_program_{make_program(compute_separable_subgroup_horizontal_compute, pixel_format::rgba8, intermediate_format())}
+			, blur_vertical_program_{make_program(compute_separable_subgroup_vertical_compute, intermediate_format(), pixel_format::rgba8)}
+			, kernel_radius_{blur_radius()}
+			, format_{intermediate_format()}
+		{
+			color_buffer_1_.linear_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_2_.linear_filter();
+			color_buffer_2_.clamp();
+
+			color_buffer_3_.linear_filter();
+			color_buffer_3_.clamp();
+		}
+
+		shared_program compute_separable_subgroup_impl::make_program(char const * body, pixel_format input, pixel_format output) const
+		{
+			if (blur_radius() > max_subgroup_radius())
+				throw std::runtime_error(util::to_string("Subgroup size ", 2 * max_subgroup_radius(), " is too small for a kernel radius of ", blur_radius()));
+
+			return services().program(util::to_string("#version 430\n#extension GL_KHR_shader_subgroup_basic : require\n#extension GL_KHR_shader_subgroup_shuffle : require\n\n#define GROUP_SIZE ", group_size, "\n", gaussian_kernel_source(blur_sigma(), blur_radius()), pixel_format_source(input, output), body));
+		}
+
+		void compute_separable_subgroup_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius() || format_ != intermediate_format())
+			{
+				kernel_radius_ = blur_radius();
+				format_ = intermediate_format();
+				blur_horizontal_program_ = make_program(compute_separable_subgroup_horizontal_compute, pixel_format::rgba8, format_);
+				blur_vertical_program_ = make_program(compute_separable_subgroup_vertical_compute, format_, pixel_format::rgba8);
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			downsampler_.resize(width, height, render_scale());
+
+			load(color_buffer_2_, format_, scaled_width(), scaled_height());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_2_.color(color_buffer_2_);
+
+			fbo_3_.color(color_buffer_3_);
+
+			fbo_1_.assert_complete();
+			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic compute_separable_subgroup_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// Every thread loads two texels and exchanges them through shuffles, not shared memory
+			blur_traffic traffic = cached_pass(scaled_width(), scaled_height(), group_size, 1, 2 * group_size, 4, 0, bytes, 0, n);
+			traffic += cached_pass(scaled_width(), scaled_height(), 1, group_size, 2 * group_size, bytes, 0, 4, 0, n);
+			return traffic;
+		}
+
+		void compute_separable_subgroup_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			fbo_2_.bind();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+				gl::Disable(gl::DEPTH_TEST);
+
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				blur_horizontal_program_.bind();
+
+				gl::BindImageTexture(0, input.id(), 0, gl::FALSE, 0, gl::READ_ONLY, gl::RGBA8);
+				gl::BindImageTexture(1, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, pixel_format_internal(format_));
+				gl::DispatchCompute((scaled_width() + group_size - 1) / group_size, scaled_height(), 1);
+
+				gl::MemoryBarrier(gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+				blur_vertical_program_.bind();
+
+				gl::BindImageTexture(0, color_buffer_2_.id(), 0, gl::FALSE, 0, gl::READ_ONLY, pixel_format_internal(format_));
+				gl::BindImageTexture(1, color_buffer_3_.id(), 0, gl::FALSE, 0, gl::WRITE_ONLY, gl::RGBA8);
+				gl::DispatchCompute(scaled_width(), (scaled_height() + group_size - 1) / group_size, 1);
+
+				gl::MemoryBarrier(gl::FRAMEBUFFER_BARRIER_BIT);
+			}
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, render_scale() > 1 ? gl::LINEAR : gl::NEAREST);
+
+			gfx::framebuffer::null().bind();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, "Compute separable subgroup", opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> compute_separable_subgroup()
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		if (!requirements_met(requires_subgroup_shuffle))
+			throw std::runtime_error("OpenGL extension KHR_shader_subgroup with compute shader shuffles not supported");
+
+		return std::make_unique<compute_separable_subgroup_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const compute_separable_subgroup_registrar{{
+			.name = "compute_separable_subgroup",
+			.factory = compute_separable_subgroup,
+			.key = SDLK_q,
+			.passes = 2,
+			.scalable = true,
+			.reference_output = true,
+			.formats = true,
+			.workgroup_x = group_size,
+			.workgroup_y = 1,
+			.requirements = requires_compute | requires_subgroup_shuffle,
+			.max_radius = max_subgroup_radius,
+		}};
+
+	}
+
+}
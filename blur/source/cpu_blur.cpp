@@ -0,0 +1,193 @@
+#include <compute/blur/cpu_blur.hpp>
+#include <compute/blur/kernel.hpp>
+
+#include <algorithm>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		// Rows per chunk handed to a thread, small enough to balance the load of a band
+		// of a few hundred rows over many threads
+		int const chunk_rows = 8;
+
+		std::uint8_t to_unorm8(float x)
+		{
+			return static_cast<std::uint8_t>(std::clamp(x, 0.f, 255.f) + 0.5f);
+		}
+
+	}
+
+	cpu_blur::cpu_blur(int threads)
+	{
+		if (threads <= 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		accumulators_.resize(threads);
+
+		for (int i = 1; i < threads; ++i)
+			workers_.emplace_back([this, i]{ worker(i); });
+	}
+
+	cpu_blur::~cpu_blur()
+	{
+		{
+			std::lock_guard lock{mutex_};
+			stop_ = true;
+		}
+		start_.notify_all();
+
+		for (auto & w : workers_)
+			w.join();
+	}
+
+	void cpu_blur::set_kernel(float sigma, int radius)
+	{
+		radius_ = radius;
+		weights_ = gaussian_weights(sigma, radius);
+	}
+
+	template <typename F>
+	void cpu_blur::parallel_rows(int rows, F const & f)
+	{
+		job_ = [](void const * context, int thread, int first, int last){
+			(*static_cast<F const *>(context))(thread, first, last);
+		};
+		context_ = &f;
+		job_rows_ = rows;
+		job_chunk_ = chunk_rows;
+		next_chunk_.store(0, std::memory_order_relaxed);
+
+		{
+			std::lock_guard lock{mutex_};
+			++generation_;
+			busy_ = static_cast<int>(workers_.size());
+		}
+		start_.notify_all();
+
+		work(0);
+
+		std::unique_lock lock{mutex_};
+		done_.wait(lock, [this]{ return busy_ == 0; });
+	}
+
+	void cpu_blur::work(int thread)
+	{
+		int const chunks = (job_rows_ + job_chunk_ - 1) / job_chunk_;
+
+		for (int chunk; (chunk = next_chunk_.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+		{
+			int const first = chunk * job_chunk_;
+			job_(context_, thread, first, std::min(job_rows_, first + job_chunk_));
+		}
+	}
+
+	void cpu_blur::worker(int thread)
+	{
+		std::uint64_t seen = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock lock{mutex_};
+				start_.wait(lock, [&]{ return stop_ || generation_ != seen; });
+				if (stop_)
+					return;
+				seen = generation_;
+			}
+
+			work(thread);
+
+			{
+				std::lock_guard lock{mutex_};
+				if (--busy_ == 0)
+					done_.notify_one();
+			}
+		}
+	}
+
+	void cpu_blur::apply(std::uint8_t const * input, int input_first, int input_rows, std::uint8_t * output,
+		int width, int height, int first, int last)
+	{
+		int const r = radius_;
+		float const * w = weights_.data();
+		std::size_t const stride = std::size_t(width) * 4;
+
+		intermediate_.resize(stride * input_rows);
+		for (auto & a : accumulators_)
+			a.resize(stride);
+
+		std::uint8_t * intermediate = intermediate_.data();
+
+		// Horizontal pass over every input row. Like the vertical one it accumulates shifted
+		// copies of the row for the pixels whose taps are inside the row, which vectorizes;
+		// the pixels within the radius of the left and right edges clamp their taps
+		parallel_rows(input_rows, [&](int thread, int begin, int end){
+			float * acc = accumulators_[thread].data();
+
+			int const interior_first = std::min(r, width);
+			int const interior_last = std::max(interior_first, width - r);
+
+			for (int y = begin; y < end; ++y)
+			{
+				std::uint8_t const * src = input + stride * y;
+				std::uint8_t * dst = intermediate + stride * y;
+
+				std::fill(acc, acc + stride, 0.f);
+
+				for (int k = 0; k <= 2 * r; ++k)
+				{
+					float const weight = w[k];
+					std::uint8_t const * shifted = src + (k - r) * 4;
+					for (std::size_t i = interior_first * 4; i < std::size_t(interior_last) * 4; ++i)
+						acc[i] += weight * shifted[i];
+				}
+
+				for (int x = 0; x < width; ++x)
+				{
+					if (x == interior_first)
+						x = interior_last;
+					if (x == width)
+						break;
+
+					for (int k = 0; k <= 2 * r; ++k)
+					{
+						std::uint8_t const * p = src + std::clamp(x + k - r, 0, width - 1) * 4;
+						for (int c = 0; c < 4; ++c)
+							acc[x * 4 + c] += w[k] * p[c];
+					}
+				}
+
+				for (std::size_t i = 0; i < stride; ++i)
+					dst[i] = to_unorm8(acc[i]);
+			}
+		});
+
+		// Vertical pass, a whole row at a time so the inner loop runs over contiguous
+		// memory; rows outside of the image are clamped to its top and bottom rows
+		parallel_rows(last - first, [&](int thread, int begin, int end){
+			float * acc = accumulators_[thread].data();
+
+			for (int y = begin; y < end; ++y)
+			{
+				std::fill(acc, acc + stride, 0.f);
+
+				for (int k = 0; k <= 2 * r; ++k)
+				{
+					int const source = std::clamp(first + y + k - r, 0, height - 1) - input_first;
+					std::uint8_t const * src = intermediate + stride * source;
+					float const weight = w[k];
+					for (std::size_t i = 0; i < stride; ++i)
+						acc[i] += weight * src[i];
+				}
+
+				std::uint8_t * dst = output + stride * y;
+				for (std::size_t i = 0; i < stride; ++i)
+					dst[i] = to_unorm8(acc[i]);
+			}
+		});
+	}
+
+}
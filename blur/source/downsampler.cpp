@@ -0,0 +1,60 @@
+#include <compute/blur/downsampler.hpp>
+
+#include <psemek/gfx/gl.hpp>
+
+#include <algorithm>
+
+namespace compute
+{
+
+	downsampler::downsampler()
+	{
+		for (auto & buffer : color_buffer_)
+		{
+			buffer.linear_filter();
+			buffer.clamp();
+		}
+	}
+
+	void downsampler::resize(int width, int height, int scale)
+	{
+		width_ = width;
+		height_ = height;
+
+		levels_ = 0;
+		for (int s = scale; s > 1 && levels_ < max_levels; s /= 2)
+			++levels_;
+
+		for (int i = 0; i < levels_; ++i)
+		{
+			color_buffer_[i].load<gfx::color_rgba>({std::max(1, width >> (i + 1)), std::max(1, height >> (i + 1))});
+			fbo_[i].color(color_buffer_[i]);
+			fbo_[i].assert_complete();
+		}
+	}
+
+	gfx::texture_2d & downsampler::apply(gfx::framebuffer & source_fbo, gfx::texture_2d & source)
+	{
+		if (levels_ == 0)
+			return source;
+
+		GLuint read = source_fbo.id();
+
+		for (int i = 0; i < levels_; ++i)
+		{
+			int const read_width = std::max(1, width_ >> i);
+			int const read_height = std::max(1, height_ >> i);
+			int const draw_width = std::max(1, width_ >> (i + 1));
+			int const draw_height = std::max(1, height_ >> (i + 1));
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, read);
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, fbo_[i].id());
+			gl::BlitFramebuffer(0, 0, read_width, read_height, 0, 0, draw_width, draw_height, gl::COLOR_BUFFER_BIT, gl::LINEAR);
+
+			read = fbo_[i].id();
+		}
+
+		return color_buffer_[levels_ - 1];
+	}
+
+}
@@ -0,0 +1,449 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/moving_average.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		char const dual_filter_vertex[] =
+R"(#version 330
+
+const vec2 vertices[3] = vec2[3](
+	vec2(-1.0, -1.0),
+	vec2( 3.0, -1.0),
+	vec2(-1.0,  3.0)
+);
+
+out vec2 texcoord;
+
+void main()
+{
+	vec2 vertex = vertices[gl_VertexID];
+	gl_Position = vec4(vertex, 0.0, 1.0);
+
+	texcoord = 0.5 * vertex + vec2(0.5);
+}
+)";
+
+		// Used both for downsampling (offset in input texels) and for upsampling
+		// (half the offset, since the input is the lower resolution level)
+		char const dual_filter_fragment[] =
+R"(#version 330
+
+uniform sampler2D u_input_texture;
+uniform vec2 u_texel;
+uniform float u_offset;
+
+layout (location = 0) out vec4 out_color;
+
+in vec2 texcoord;
+
+void main()
+{
+	vec2 d = u_offset * u_texel;
+
+	out_color = 0.25 * (
+		texture(u_input_texture, texcoord + vec2(-d.x, -d.y)) +
+		texture(u_input_texture, texcoord + vec2( d.x, -d.y)) +
+		texture(u_input_texture, texcoord + vec2(-d.x,  d.y)) +
+		texture(u_input_texture, texcoord + vec2( d.x,  d.y))
+	);
+}
+)";
+
+		// Both filters are separable, so the pyramid is modelled in 1D: an impulse is pushed
+		// through the same downsample/upsample chain on the CPU, and the resulting kernel is
+		// compared with the exact Gaussian
+
+		double bilinear_sample(std::vector<double> const & data, double x)
+		{
+			double const u = x - 0.5;
+			double const i = std::floor(u);
+			double const t = u - i;
+
+			int const last = static_cast<int>(data.size()) - 1;
+			int const i0 = std::clamp(static_cast<int>(i), 0, last);
+			int const i1 = std::clamp(static_cast<int>(i) + 1, 0, last);
+
+			return data[i0] * (1.0 - t) + data[i1] * t;
+		}
+
+		std::vector<double> downsample(std::vector<double> const & data, double offset)
+		{
+			std::vector<double> result(data.size() / 2);
+			for (std::size_t j = 0; j < result.size(); ++j)
+			{
+				double const x = 2.0 * j + 1.0;
+				result[j] = 0.5 * (bilinear_sample(data, x - offset) + bilinear_sample(data, x + offset));
+			}
+			return result;
+		}
+
+		std::vector<double> upsample(std::vector<double> const & data, double offset)
+		{
+			std::vector<double> result(data.size() * 2);
+			for (std::size_t j = 0; j < result.size(); ++j)
+			{
+				double const x = (j + 0.5) / 2.0;
+				result[j] = 0.5 * (bilinear_sample(data, x - 0.5 * offset) + bilinear_sample(data, x + 0.5 * offset));
+			}
+			return result;
+		}
+
+		struct dual_filter_fit
+		{
+			int levels;
+			float offset;
+			float sigma;
+			float error;
+		};
+
+		dual_filter_fit evaluate(int levels, double offset, double requested_sigma)
+		{
+			int const size = 64 << levels;
+			int const period = 1 << levels;
+
+			// The pyramid is not shift-invariant, so average over several impulse phases
+			int const phases = std::min(period, 4);
+
+			double sigma = 0.0;
+			double error = 0.0;
+
+			for (int p = 0; p < phases; ++p)
+			{
+				int const position = size / 2 + p * period / phases;
+
+				std::vector<double> data(size, 0.0);
+				data[position] = 1.0;
+
+				for (int l = 0; l < levels; ++l)
+					data = downsample(data, offset);
+				for (int l = 0; l < levels; ++l)
+					data = upsample(data, offset);
+
+				double total = 0.0;
+				double mean = 0.0;
+				for (int x = 0; x < size; ++x)
+				{
+					total += data[x];
+					mean += data[x] * x;
+				}
+				mean /= total;
+
+				double variance = 0.0;
+				for (int x = 0; x < size; ++x)
+					variance += data[x] * (x - mean) * (x - mean);
+				sigma += std::sqrt(variance / total);
+
+				std::vector<double> gaussian(size);
+				double gaussian_total = 0.0;
+				for (int x = 0; x < size; ++x)
+				{
+					double const d = (x - position) / requested_sigma;
+					gaussian[x] = std::exp(-0.5 * d * d);
+					gaussian_total += gaussian[x];
+				}
+
+				for (int x = 0; x < size; ++x)
+					error += std::abs(data[x] - gaussian[x] / gaussian_total);
+			}
+
+			return {levels, static_cast<float>(offset), static_cast<float>(sigma / phases), static_cast<float>(error / phases)};
+		}
+
+		// Searches levels and tap offsets for the pyramid closest to the requested Gaussian.
+		// The effective sigma is not monotonic in the offset (bilinear taps alias at some
+		// offsets), so this is a plain grid search rather than a bisection
+		dual_filter_fit fit(float requested_sigma, int max_levels)
+		{
+			double const min_offset = 0.5;
+			double const max_offset = 2.0;
+			int const offset_steps = 15;
+
+			dual_filter_fit best = evaluate(1, min_offset, requested_sigma);
+
+			for (int levels = 1; levels <= max_levels; ++levels)
+			{
+				// With offsets in [0.5, 2] the effective sigma stays
+				// within [0.4, 2] * 2^levels, skip levels that can't match
+				double const scale = 1 << levels;
+				if (requested_sigma < 0.4 * scale || requested_sigma > 2.0 * scale)
+					continue;
+
+				for (int i = 0; i <= offset_steps; ++i)
+				{
+					double const offset = min_offset + (max_offset - min_offset) * i / offset_steps;
+					auto const candidate = evaluate(levels, offset, requested_sigma);
+					if (candidate.error < best.error)
+						best = candidate;
+				}
+			}
+
+			return best;
+		}
+
+		struct dual_filter_impl
+			: scene
+		{
+			dual_filter_impl();
+
+			void on_resize(int width, int height) override;
+
+			void on_key_down(SDL_Keycode key) override;
+
+			void present() override;
+
+		private:
+			static constexpr int max_levels = 8;
+
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			// level_fbo_[i] holds pyramid level i + 1, level 0 is color_buffer_1_
+			gfx::framebuffer level_fbo_[max_levels];
+			gfx::texture_2d level_buffer_[max_levels];
+			geom::vector<int, 2> level_size_[max_levels + 1];
+
+			shared_program blur_program_ = services().program(dual_filter_vertex, dual_filter_fragment);
+
+			gfx::array & vao_ = services().fullscreen_vao;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			float requested_sigma_ = 10.f;
+			int available_levels_ = max_levels;
+			dual_filter_fit fit_{1, 1.f, 0.f, 0.f};
+
+			pixel_format format_ = pixel_format::rgba8;
+
+			blur_traffic traffic() const;
+		};
+
+		dual_filter_impl::dual_filter_impl()
+		{
+			color_buffer_1_.linear_filter();
+			color_buffer_1_.clamp();
+
+			for (auto & buffer : level_buffer_)
+			{
+				buffer.linear_filter();
+				buffer.clamp();
+			}
+		}
+
+		void dual_filter_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_1_.assert_complete();
+
+			level_size_[0] = {width, height};
+
+			format_ = intermediate_format();
+
+			available_levels_ = 0;
+			for (int i = 0; i < max_levels; ++i)
+			{
+				level_size_[i + 1] = {std::max(1, width >> (i + 1)), std::max(1, height >> (i + 1))};
+
+				load(level_buffer_[i], format_, level_size_[i + 1][0], level_size_[i + 1][1]);
+				level_fbo_[i].color(level_buffer_[i]);
+				level_fbo_[i].assert_complete();
+
+				if (level_size_[i + 1][0] >= 2 && level_size_[i + 1][1] >= 2)
+					available_levels_ = i + 1;
+			}
+
+			fit_ = fit(requested_sigma_, available_levels_);
+
+			report_traffic(traffic());
+		}
+
+		void dual_filter_impl::on_key_down(SDL_Keycode key)
+		{
+			scene::on_key_down(key);
+
+			if (key == SDLK_MINUS)
+			{
+				requested_sigma_ = std::max(1.f, requested_sigma_ / 1.25f);
+				fit_ = fit(requested_sigma_, available_levels_);
+				report_traffic(traffic());
+			}
+			else if (key == SDLK_EQUALS)
+			{
+				requested_sigma_ = std::min(500.f, requested_sigma_ * 1.25f);
+				fit_ = fit(requested_sigma_, available_levels_);
+				report_traffic(traffic());
+			}
+		}
+
+		blur_traffic dual_filter_impl::traffic() const
+		{
+			int const bytes = pixel_format_bytes(format_);
+
+			// Four bilinear fetches of 2x2 texels per pixel, both down and up
+			blur_traffic traffic;
+			for (int i = 1; i <= fit_.levels; ++i)
+				traffic += direct_pass(level_size_[i][0], level_size_[i][1], 16, (i == 1) ? 4 : bytes, bytes, 4);
+			for (int i = fit_.levels - 1; i >= 0; --i)
+				traffic += direct_pass(level_size_[i][0], level_size_[i][1], 16, bytes, (i == 0) ? 4 : bytes, 4);
+			return traffic;
+		}
+
+		void dual_filter_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				gl::Disable(gl::DEPTH_TEST);
+
+				blur_program_.bind();
+				blur_program_["u_input_texture"] = 0;
+				vao_.bind();
+
+				blur_program_["u_offset"] = fit_.offset;
+
+				for (int i = 1; i <= fit_.levels; ++i)
+				{
+					auto const & input_size = level_size_[i - 1];
+					auto const & output_size = level_size_[i];
+
+					level_fbo_[i - 1].bind();
+					gl::Viewport(0, 0, output_size[0], output_size[1]);
+
+					if (i == 1)
+						color_buffer_1_.bind(0);
+					else
+						level_buffer_[i - 2].bind(0);
+
+					blur_program_["u_texel"] = geom::vector{1.f / input_size[0], 1.f / input_size[1]};
+
+					gl::DrawArrays(gl::TRIANGLES, 0, 3);
+				}
+
+				blur_program_["u_offset"] = 0.5f * fit_.offset;
+
+				// Upsampled results overwrite the downsampled levels, which are no longer needed
+				for (int i = fit_.levels - 1; i >= 0; --i)
+				{
+					auto const & input_size = level_size_[i + 1];
+					auto const & output_size = level_size_[i];
+
+					if (i == 0)
+						gfx::framebuffer::null().bind();
+					else
+						level_fbo_[i - 1].bind();
+
+					gl::Viewport(0, 0, output_size[0], output_size[1]);
+
+					level_buffer_[i].bind(0);
+					blur_program_["u_texel"] = geom::vector{1.f / input_size[0], 1.f / input_size[1]};
+
+					gl::DrawArrays(gl::TRIANGLES, 0, 3);
+				}
+			}
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, "Dual filter", opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				painter_.text({20.f, 80.f}, frame_text("Sigma: ", requested_sigma_, " (effective ", fit_.sigma, ")"), opts);
+
+				painter_.text({20.f, 100.f}, frame_text("Levels: ", fit_.levels, ", offset: ", fit_.offset), opts);
+
+				painter_.text({20.f, 120.f}, frame_text("L1 error vs Gaussian: ", fit_.error * 100.f, "%"), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 140.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 160.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> dual_filter()
+	{
+		return std::make_unique<dual_filter_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const dual_filter_registrar{{
+			.name = "dual_filter",
+			.factory = dual_filter,
+			.key = SDLK_t,
+			.passes = 0,
+		}};
+
+	}
+
+}
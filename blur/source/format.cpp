@@ -0,0 +1,324 @@
+#include <compute/blur/format.hpp>
+
+#include <psemek/util/to_string.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		char const rgba8_packing[] =
+R"(#define lds_t uint
+
+lds_t pack_lds(vec4 v)
+{
+	return packUnorm4x8(v);
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	return unpackUnorm4x8(x);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return raw.x;
+}
+)";
+
+		char const rgb10a2_packing[] =
+R"(#define lds_t uint
+
+lds_t pack_lds(vec4 v)
+{
+	uvec4 q = uvec4(round(clamp(v, 0.0, 1.0) * vec4(1023.0, 1023.0, 1023.0, 3.0)));
+	return q.r | (q.g << 10) | (q.b << 20) | (q.a << 30);
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	uvec4 q = uvec4(x, x >> 10, x >> 20, x >> 30) & uvec4(0x3ffu, 0x3ffu, 0x3ffu, 0x3u);
+	return vec4(q) / vec4(1023.0, 1023.0, 1023.0, 3.0);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return raw.x;
+}
+)";
+
+		// 11 and 10 bit floats share the exponent bias of half floats and have no sign,
+		// so they are the top bits of the corresponding half (truncating the mantissa)
+		char const r11g11b10f_packing[] =
+R"(#define lds_t uint
+
+lds_t pack_lds(vec4 v)
+{
+	v = max(v, vec4(0.0));
+	uint rg = packHalf2x16(v.rg);
+	uint b = packHalf2x16(vec2(v.b, 0.0));
+	return ((rg >> 4) & 0x7ffu) | (((rg >> 20) & 0x7ffu) << 11) | (((b >> 5) & 0x3ffu) << 22);
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	vec2 rg = unpackHalf2x16(((x & 0x7ffu) << 4) | (((x >> 11) & 0x7ffu) << 20));
+	float b = unpackHalf2x16(((x >> 22) & 0x3ffu) << 5).x;
+	return vec4(rg, b, 1.0);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return raw.x;
+}
+)";
+
+		char const rgba16f_packing[] =
+R"(#define lds_t uvec2
+
+lds_t pack_lds(vec4 v)
+{
+	return uvec2(packHalf2x16(v.rg), packHalf2x16(v.ba));
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	return vec4(unpackHalf2x16(x.x), unpackHalf2x16(x.y));
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return raw.xy;
+}
+)";
+
+		char const rgba32f_packing[] =
+R"(#define lds_t uvec4
+
+lds_t pack_lds(vec4 v)
+{
+	return floatBitsToUint(v);
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	return uintBitsToFloat(x);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return raw;
+}
+)";
+
+		// Single and two channel texels take a whole 32-bit shared memory element, there's
+		// nothing to gain from packing them
+
+		char const r8_packing[] =
+R"(#define lds_t float
+
+lds_t pack_lds(vec4 v)
+{
+	return v.r;
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	return vec4(x, 0.0, 0.0, 1.0);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return float(raw.x) / 255.0;
+}
+)";
+
+		char const r16f_packing[] =
+R"(#define lds_t float
+
+lds_t pack_lds(vec4 v)
+{
+	return v.r;
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	return vec4(x, 0.0, 0.0, 1.0);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return unpackHalf2x16(raw.x).x;
+}
+)";
+
+		char const rg8_packing[] =
+R"(#define lds_t vec2
+
+lds_t pack_lds(vec4 v)
+{
+	return v.rg;
+}
+
+vec4 unpack_lds(lds_t x)
+{
+	return vec4(x, 0.0, 1.0);
+}
+
+lds_t lds_from_raw(uvec4 raw)
+{
+	return vec2(raw.xy) / 255.0;
+}
+)";
+
+		char const * glsl_qualifier(pixel_format format)
+		{
+			switch (format)
+			{
+			case pixel_format::rgba8: return "rgba8";
+			case pixel_format::rgb10a2: return "rgb10_a2";
+			case pixel_format::r11g11b10f: return "r11f_g11f_b10f";
+			case pixel_format::rgba16f: return "rgba16f";
+			case pixel_format::rgba32f: return "rgba32f";
+			case pixel_format::r8: return "r8";
+			case pixel_format::r16f: return "r16f";
+			case pixel_format::rg8: return "rg8";
+			}
+			return "rgba8";
+		}
+
+		char const * glsl_raw_qualifier(pixel_format format)
+		{
+			switch (format)
+			{
+			case pixel_format::r8: return "r8ui";
+			case pixel_format::r16f: return "r16ui";
+			case pixel_format::rg8: return "rg8ui";
+			default: break;
+			}
+
+			switch (pixel_format_bytes(format))
+			{
+			case 8: return "rg32ui";
+			case 16: return "rgba32ui";
+			default: return "r32ui";
+			}
+		}
+
+		char const * glsl_packing(pixel_format format)
+		{
+			switch (format)
+			{
+			case pixel_format::rgba8: return rgba8_packing;
+			case pixel_format::rgb10a2: return rgb10a2_packing;
+			case pixel_format::r11g11b10f: return r11g11b10f_packing;
+			case pixel_format::rgba16f: return rgba16f_packing;
+			case pixel_format::rgba32f: return rgba32f_packing;
+			case pixel_format::r8: return r8_packing;
+			case pixel_format::r16f: return r16f_packing;
+			case pixel_format::rg8: return rg8_packing;
+			}
+			return rgba8_packing;
+		}
+
+	}
+
+	char const * pixel_format_name(pixel_format format)
+	{
+		switch (format)
+		{
+		case pixel_format::rgba8: return "RGBA8";
+		case pixel_format::rgb10a2: return "RGB10A2";
+		case pixel_format::r11g11b10f: return "R11G11B10F";
+		case pixel_format::rgba16f: return "RGBA16F";
+		case pixel_format::rgba32f: return "RGBA32F";
+		case pixel_format::r8: return "R8";
+		case pixel_format::r16f: return "R16F";
+		case pixel_format::rg8: return "RG8";
+		}
+		return "unknown";
+	}
+
+	GLenum pixel_format_internal(pixel_format format)
+	{
+		switch (format)
+		{
+		case pixel_format::rgba8: return gl::RGBA8;
+		case pixel_format::rgb10a2: return gl::RGB10_A2;
+		case pixel_format::r11g11b10f: return gl::R11F_G11F_B10F;
+		case pixel_format::rgba16f: return gl::RGBA16F;
+		case pixel_format::rgba32f: return gl::RGBA32F;
+		case pixel_format::r8: return gl::R8;
+		case pixel_format::r16f: return gl::R16F;
+		case pixel_format::rg8: return gl::RG8;
+		}
+		return gl::RGBA8;
+	}
+
+	GLenum pixel_format_raw_internal(pixel_format format)
+	{
+		switch (format)
+		{
+		case pixel_format::r8: return gl::R8UI;
+		case pixel_format::r16f: return gl::R16UI;
+		case pixel_format::rg8: return gl::RG8UI;
+		default: break;
+		}
+
+		switch (pixel_format_bytes(format))
+		{
+		case 8: return gl::RG32UI;
+		case 16: return gl::RGBA32UI;
+		default: return gl::R32UI;
+		}
+	}
+
+	int pixel_format_bytes(pixel_format format)
+	{
+		switch (format)
+		{
+		case pixel_format::rgba16f: return 8;
+		case pixel_format::rgba32f: return 16;
+		case pixel_format::r8: return 1;
+		case pixel_format::r16f: return 2;
+		case pixel_format::rg8: return 2;
+		default: return 4;
+		}
+	}
+
+	int pixel_format_channels(pixel_format format)
+	{
+		switch (format)
+		{
+		case pixel_format::r11g11b10f: return 3;
+		case pixel_format::r8: return 1;
+		case pixel_format::r16f: return 1;
+		case pixel_format::rg8: return 2;
+		default: return 4;
+		}
+	}
+
+	void load(gfx::texture_2d & texture, pixel_format format, int width, int height)
+	{
+		gl::BindTexture(gl::TEXTURE_2D, texture.id());
+		GLenum const layout[] = {gl::RED, gl::RG, gl::RGB, gl::RGBA};
+		gl::TexImage2D(gl::TEXTURE_2D, 0, pixel_format_internal(format), width, height, 0,
+			layout[pixel_format_channels(format) - 1], gl::FLOAT, nullptr);
+	}
+
+	std::string pixel_format_packing_source(pixel_format format)
+	{
+		return glsl_packing(format);
+	}
+
+	std::string pixel_format_source(pixel_format input, pixel_format output)
+	{
+		return util::to_string(
+			"#define INPUT_FORMAT ", glsl_qualifier(input), "\n",
+			"#define INPUT_RAW_FORMAT ", glsl_raw_qualifier(input), "\n",
+			"#define OUTPUT_FORMAT ", glsl_qualifier(output), "\n\n",
+			glsl_packing(input), "\n");
+	}
+
+}
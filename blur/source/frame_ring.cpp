@@ -0,0 +1,162 @@
+#include <compute/blur/frame_ring.hpp>
+
+#include <cassert>
+
+namespace compute
+{
+
+	frame_ring::frame_ring(int width, int height, int slots)
+		: width_(width)
+		, height_(height)
+		, frame_bytes_(std::size_t(width) * height * 4)
+		, slots_(slots)
+	{
+		GLbitfield const flags = gl::MAP_WRITE_BIT | gl::MAP_PERSISTENT_BIT | gl::MAP_COHERENT_BIT;
+
+		gl::GenBuffers(1, &buffer_);
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, buffer_);
+		gl::BufferStorage(gl::PIXEL_UNPACK_BUFFER, frame_bytes_ * slots, nullptr, flags);
+		mapping_ = static_cast<std::uint8_t *>(gl::MapBufferRange(gl::PIXEL_UNPACK_BUFFER, 0, frame_bytes_ * slots, flags));
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	frame_ring::~frame_ring()
+	{
+		for (auto & s : slots_)
+			if (s.fence)
+				gl::DeleteSync(s.fence);
+
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, buffer_);
+		gl::UnmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+		gl::DeleteBuffers(1, &buffer_);
+	}
+
+	frame_ring::write_slot frame_ring::begin_write()
+	{
+		std::unique_lock lock{mutex_};
+
+		while (!closed_)
+		{
+			int free = -1;
+			int oldest_ready = -1;
+
+			for (int i = 0; i < static_cast<int>(slots_.size()); ++i)
+			{
+				if (slots_[i].state == slot_state::free && free == -1)
+					free = i;
+				if (slots_[i].state == slot_state::ready && (oldest_ready == -1 || slots_[i].sequence < slots_[oldest_ready].sequence))
+					oldest_ready = i;
+			}
+
+			if (free == -1 && oldest_ready != -1)
+			{
+				free = oldest_ready;
+				++frames_dropped_;
+			}
+
+			if (free != -1)
+			{
+				slots_[free].state = slot_state::writing;
+				return {mapping_ + frame_bytes_ * free, free};
+			}
+
+			released_.wait(lock);
+		}
+
+		return {};
+	}
+
+	void frame_ring::end_write(write_slot const & slot)
+	{
+		std::lock_guard lock{mutex_};
+
+		if (!slot)
+			return;
+
+		auto & s = slots_[slot.index];
+		assert(s.state == slot_state::writing);
+
+		s.state = slot_state::ready;
+		s.written = clock_type::now();
+		s.sequence = next_sequence_++;
+	}
+
+	void frame_ring::poll()
+	{
+		for (auto & s : slots_)
+		{
+			if (s.state != slot_state::reading || !s.fence)
+				continue;
+
+			if (gl::ClientWaitSync(s.fence, 0, 0) == gl::TIMEOUT_EXPIRED)
+				continue;
+
+			gl::DeleteSync(s.fence);
+			s.fence = nullptr;
+			s.state = slot_state::free;
+			released_.notify_all();
+		}
+	}
+
+	std::optional<frame_ring::frame> frame_ring::begin_read()
+	{
+		std::lock_guard lock{mutex_};
+
+		poll();
+
+		int newest = -1;
+		for (int i = 0; i < static_cast<int>(slots_.size()); ++i)
+			if (slots_[i].state == slot_state::ready && (newest == -1 || slots_[i].sequence > slots_[newest].sequence))
+				newest = i;
+
+		if (newest == -1)
+			return std::nullopt;
+
+		// Older frames are superseded by the newest one
+		for (auto & s : slots_)
+		{
+			if (s.state == slot_state::ready && &s != &slots_[newest])
+			{
+				s.state = slot_state::free;
+				++frames_dropped_;
+			}
+		}
+
+		released_.notify_all();
+
+		slots_[newest].state = slot_state::reading;
+		reading_ = newest;
+
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, buffer_);
+
+		return frame{frame_bytes_ * newest, slots_[newest].written};
+	}
+
+	void frame_ring::end_read()
+	{
+		std::lock_guard lock{mutex_};
+
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+		if (reading_ == -1)
+			return;
+
+		slots_[reading_].fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+		reading_ = -1;
+	}
+
+	std::size_t frame_ring::frames_dropped() const
+	{
+		std::lock_guard lock{mutex_};
+		return frames_dropped_;
+	}
+
+	void frame_ring::close()
+	{
+		std::lock_guard lock{mutex_};
+		closed_ = true;
+		released_.notify_all();
+	}
+
+}
@@ -0,0 +1,84 @@
+#include <compute/blur/frame_text.hpp>
+
+#include <streambuf>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		constexpr std::size_t buffer_size = 64 * 1024;
+
+		// Texts starting closer to the end of the buffer start over at its beginning instead.
+		// Longer texts are truncated if they don't fit into the rest of the buffer
+		constexpr std::size_t max_text_size = 1024;
+
+		// The put area is the free part of the buffer; the default overflow() fails the stream
+		// instead of growing anything once it's full
+		struct arena_buffer
+			: std::streambuf
+		{
+			void begin()
+			{
+				if (buffer_size - used_ < max_text_size)
+					used_ = 0;
+
+				setp(data_ + used_, data_ + buffer_size);
+			}
+
+			std::string_view end()
+			{
+				std::string_view const text{pbase(), static_cast<std::size_t>(pptr() - pbase())};
+				used_ = pptr() - data_;
+				return text;
+			}
+
+			void reset()
+			{
+				used_ = 0;
+			}
+
+		private:
+			char data_[buffer_size];
+			std::size_t used_ = 0;
+		};
+
+		struct arena
+		{
+			arena_buffer buffer;
+			std::ostream stream{&buffer};
+		};
+
+		arena & thread_arena()
+		{
+			thread_local arena result;
+			return result;
+		}
+
+	}
+
+	namespace frame_text_detail
+	{
+
+		std::ostream & begin()
+		{
+			auto & a = thread_arena();
+			a.buffer.begin();
+			a.stream.clear();
+			return a.stream;
+		}
+
+		std::string_view end()
+		{
+			return thread_arena().buffer.end();
+		}
+
+	}
+
+	void reset_frame_text()
+	{
+		thread_arena().buffer.reset();
+	}
+
+}
@@ -0,0 +1,441 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/cpu_blur.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		char const hybrid_vertex[] =
+R"(#version 330
+
+const vec2 vertices[3] = vec2[3](
+	vec2(-1.0, -1.0),
+	vec2( 3.0, -1.0),
+	vec2(-1.0,  3.0)
+);
+
+out vec2 texcoord;
+
+void main()
+{
+	vec2 vertex = vertices[gl_VertexID];
+	gl_Position = vec4(vertex, 0.0, 1.0);
+
+	texcoord = 0.5 * vertex + vec2(0.5);
+}
+)";
+
+		// M, N and coeffs are prepended by make_program
+
+		char const hybrid_fragment[] =
+R"(
+uniform sampler2D u_input_texture;
+uniform vec2 u_direction;
+
+layout (location = 0) out vec4 out_color;
+
+in vec2 texcoord;
+
+void main()
+{
+	vec4 sum = vec4(0.0);
+
+	for (int i = 0; i < N; ++i)
+	{
+		vec2 tc = texcoord + u_direction * float(i - M);
+		sum += coeffs[i] * texture(u_input_texture, tc);
+	}
+
+	out_color = sum;
+}
+)";
+
+		// The split moves in bands of this many rows
+		int const band_rows = 16;
+
+		// Fraction of the way to the balanced split moved per frame, and the share of the
+		// rows each side keeps so that both of their costs stay measured
+		float const rebalance_rate = 0.2f;
+		float const min_share = 0.05f;
+
+		// Blurs the bottom rows of the frame with the separable fragment shader passes and the
+		// rest with a multithreaded CPU blur at the same time. The CPU band (with the rows
+		// within the kernel radius below it) is read back through a pixel pack buffer and
+		// written back through a pixel unpack buffer, the CPU blurring straight from one
+		// mapping into the other while the GPU blurs its band.
+		//
+		// Every frame the split moves towards the one that would make both sides take equally
+		// long, according to their measured per-row costs. As it needs no compute shaders, it
+		// is also the fallback for variants the context doesn't support
+		struct hybrid_impl
+			: scene
+		{
+			hybrid_impl();
+			~hybrid_impl();
+
+			void on_resize(int width, int height) override;
+
+			void present() override;
+
+		private:
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::framebuffer fbo_2_;
+			gfx::texture_2d color_buffer_2_;
+
+			// Receives the blurred CPU band, which is then blitted to the screen
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			GLuint readback_buffer_ = 0;
+			GLuint upload_buffer_ = 0;
+
+			shared_program blur_program_;
+
+			gfx::array & vao_ = services().fullscreen_vao;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+			util::moving_average<float> gpu_time_{32};
+			util::moving_average<float> cpu_time_{32};
+
+			cpu_blur cpu_;
+			int kernel_radius_;
+
+			// Rows [0, split_) are blurred by the GPU
+			int split_ = 0;
+			float gpu_share_ = 0.5f;
+
+			// Smoothed milliseconds per row of each side, zero until measured
+			float gpu_row_ms_ = 0.f;
+			float cpu_row_ms_ = 0.f;
+
+			float last_cpu_ms_ = 0.f;
+
+			shared_program make_program(char const * body) const;
+
+			void blur_gpu_band(int split);
+			float blur_cpu_band(int split, GLsync readback);
+
+			void rebalance();
+
+			blur_traffic traffic() const;
+		};
+
+		hybrid_impl::hybrid_impl()
+			: blur_program_{make_program(hybrid_fragment)}
+			, kernel_radius_{blur_radius()}
+		{
+			color_buffer_1_.nearest_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_2_.nearest_filter();
+			color_buffer_2_.clamp();
+
+			color_buffer_3_.nearest_filter();
+			color_buffer_3_.clamp();
+
+			gl::GenBuffers(1, &readback_buffer_);
+			gl::GenBuffers(1, &upload_buffer_);
+
+			cpu_.set_kernel(blur_sigma(), blur_radius());
+		}
+
+		hybrid_impl::~hybrid_impl()
+		{
+			gl::DeleteBuffers(1, &readback_buffer_);
+			gl::DeleteBuffers(1, &upload_buffer_);
+		}
+
+		shared_program hybrid_impl::make_program(char const * body) const
+		{
+			return services().program(hybrid_vertex, util::to_string("#version 330\n\n", gaussian_kernel_source(blur_sigma(), blur_radius()), body));
+		}
+
+		void hybrid_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius())
+			{
+				kernel_radius_ = blur_radius();
+				blur_program_ = make_program(hybrid_fragment);
+				cpu_.set_kernel(blur_sigma(), blur_radius());
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			color_buffer_2_.load<gfx::color_rgba>({width, height});
+			color_buffer_3_.load<gfx::color_rgba>({width, height});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_2_.color(color_buffer_2_);
+
+			fbo_3_.color(color_buffer_3_);
+
+			fbo_1_.assert_complete();
+			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			std::size_t const bytes = std::size_t(width) * height * 4;
+
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, readback_buffer_);
+			gl::BufferData(gl::PIXEL_PACK_BUFFER, bytes, nullptr, gl::STREAM_READ);
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+			gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, upload_buffer_);
+			gl::BufferData(gl::PIXEL_UNPACK_BUFFER, bytes, nullptr, gl::STREAM_DRAW);
+			gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+			// The measured costs per row still hold at a new size
+			rebalance();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic hybrid_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const gpu_input = std::min(height(), split_ + m);
+			int const cpu_input = height() - std::max(0, split_ - m);
+
+			// The horizontal pass covers the rows the vertical one reads
+			blur_traffic traffic = direct_pass(width(), gpu_input, n, 4, 4, n);
+			traffic += direct_pass(width(), split_, n, 4, 4, n);
+
+			// The CPU band's round trip, read back with its apron and written back without
+			traffic += direct_pass(width(), cpu_input, 1, 4, 4, 0);
+			traffic += direct_pass(width(), height() - split_, 1, 4, 4, 0);
+			return traffic;
+		}
+
+		void hybrid_impl::rebalance()
+		{
+			if (gpu_row_ms_ > 0.f && cpu_row_ms_ > 0.f)
+			{
+				// Both sides finish together when the GPU share of the rows is c / (g + c)
+				float const balanced = cpu_row_ms_ / (gpu_row_ms_ + cpu_row_ms_);
+				gpu_share_ += rebalance_rate * (balanced - gpu_share_);
+				gpu_share_ = std::clamp(gpu_share_, min_share, 1.f - min_share);
+			}
+
+			int const bands = (height() + band_rows - 1) / band_rows;
+			int const gpu_bands = std::clamp(static_cast<int>(std::round(gpu_share_ * bands)), 1, std::max(1, bands - 1));
+			split_ = std::clamp(gpu_bands * band_rows, 1, std::max(1, height() - 1));
+		}
+
+		void hybrid_impl::blur_gpu_band(int split)
+		{
+			int const input_rows = std::min(height(), split + blur_radius());
+
+			gl::Disable(gl::DEPTH_TEST);
+			gl::Enable(gl::SCISSOR_TEST);
+
+			fbo_2_.bind();
+			gl::Scissor(0, 0, width(), input_rows);
+
+			blur_program_.bind();
+			blur_program_["u_input_texture"] = 0;
+			blur_program_["u_direction"] = geom::vector{1.f / width(), 0.f};
+			color_buffer_1_.bind(0);
+			vao_.bind();
+
+			gl::DrawArrays(gl::TRIANGLES, 0, 3);
+
+			gfx::framebuffer::null().bind();
+			gl::Scissor(0, 0, width(), split);
+
+			color_buffer_2_.bind(0);
+			blur_program_["u_direction"] = geom::vector{0.f, 1.f / height()};
+
+			gl::DrawArrays(gl::TRIANGLES, 0, 3);
+
+			gl::Disable(gl::SCISSOR_TEST);
+		}
+
+		float hybrid_impl::blur_cpu_band(int split, GLsync readback)
+		{
+			int const input_first = std::max(0, split - blur_radius());
+			std::size_t const stride = std::size_t(width()) * 4;
+
+			while (gl::ClientWaitSync(readback, gl::SYNC_FLUSH_COMMANDS_BIT, 1000000) == gl::TIMEOUT_EXPIRED)
+			{}
+			gl::DeleteSync(readback);
+
+			// The wait covers drawing the scene, the CPU's share starts here
+			util::clock<std::chrono::duration<float, std::milli>, std::chrono::high_resolution_clock> clock;
+
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, readback_buffer_);
+			auto input = static_cast<std::uint8_t const *>(gl::MapBufferRange(gl::PIXEL_PACK_BUFFER, 0, stride * (height() - input_first), gl::MAP_READ_BIT));
+
+			gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, upload_buffer_);
+			auto output = static_cast<std::uint8_t *>(gl::MapBufferRange(gl::PIXEL_UNPACK_BUFFER, 0, stride * (height() - split),
+				gl::MAP_WRITE_BIT | gl::MAP_INVALIDATE_BUFFER_BIT));
+
+			cpu_.apply(input, input_first, height() - input_first, output, width(), height(), split, height());
+
+			gl::UnmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, readback_buffer_);
+			gl::UnmapBuffer(gl::PIXEL_PACK_BUFFER);
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+			gl::BindTexture(gl::TEXTURE_2D, color_buffer_3_.id());
+			gl::TexSubImage2D(gl::TEXTURE_2D, 0, 0, split, width(), height() - split, gl::RGBA, gl::UNSIGNED_BYTE, nullptr);
+			gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+			return clock.count();
+		}
+
+		void hybrid_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			int const split = split_;
+
+			// Rows of the CPU band and the apron below it
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_1_.id());
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, readback_buffer_);
+			int const input_first = std::max(0, split - blur_radius());
+			gl::ReadPixels(0, input_first, width(), height() - input_first, gl::RGBA, gl::UNSIGNED_BYTE, nullptr);
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+			GLsync const readback = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+			gl::Flush();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				// The frame is done when the slower side is
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this, split](GLint value){
+					float const ms = value / 1e6f;
+					gpu_time_.push(ms);
+					gpu_row_ms_ = (gpu_row_ms_ > 0.f) ? 0.9f * gpu_row_ms_ + 0.1f * ms / split : ms / split;
+
+					blur_time_.push(std::max(ms, last_cpu_ms_));
+					report_blur_time(std::max(ms, last_cpu_ms_));
+				});
+
+				blur_gpu_band(split);
+			}
+
+			// Waiting for the readback fence only flushes if it isn't signalled yet, so without
+			// this the GPU band could sit in the command buffer until the CPU band is done
+			gl::Flush();
+
+			{
+				profile_scope const scope{"cpu band"};
+
+				last_cpu_ms_ = blur_cpu_band(split, readback);
+				cpu_time_.push(last_cpu_ms_);
+
+				float const row_ms = last_cpu_ms_ / (height() - split);
+				cpu_row_ms_ = (cpu_row_ms_ > 0.f) ? 0.9f * cpu_row_ms_ + 0.1f * row_ms : row_ms;
+			}
+
+			gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+			gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+			gl::BlitFramebuffer(0, split, width(), height(), 0, split, width(), height(), gl::COLOR_BUFFER_BIT, gl::NEAREST);
+
+			gfx::framebuffer::null().bind();
+			gl::Viewport(0, 0, width(), height());
+
+			rebalance();
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, "Hybrid CPU and GPU", opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (gpu_time_.count() > 0)
+					painter_.text({20.f, 80.f}, frame_text("GPU band: ", split_, " rows, ", gpu_time_.average(), "ms"), opts);
+
+				painter_.text({20.f, 100.f}, frame_text("CPU band: ", height() - split_, " rows on ", cpu_.threads(), " threads, ", cpu_time_.average(), "ms"), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> hybrid()
+	{
+		return std::make_unique<hybrid_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const hybrid_registrar{{
+			.name = "hybrid",
+			.factory = hybrid,
+			.key = SDLK_h,
+			.passes = 2,
+			.reference_output = true,
+		}};
+
+	}
+
+}
@@ -0,0 +1,511 @@
+#include <compute/blur/image_batch.hpp>
+#include <compute/blur/batch.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		using clock_type = std::chrono::steady_clock;
+
+		double seconds_since(clock_type::time_point start)
+		{
+			return std::chrono::duration<double>(clock_type::now() - start).count();
+		}
+
+		struct image
+		{
+			int width = 0;
+			int height = 0;
+
+			// Tightly packed RGBA8, empty if the image couldn't be read or blurred
+			std::vector<std::uint8_t> pixels;
+
+			// Why pixels is empty
+			std::string error;
+		};
+
+		// Reads a token of a PNM header, skipping whitespace and comments
+		std::string header_token(std::istream & input)
+		{
+			std::string token;
+			while (true)
+			{
+				int c = input.get();
+				if (c == EOF)
+					return token;
+
+				if (c == '#' && token.empty())
+				{
+					while (c != EOF && c != '\n')
+						c = input.get();
+					continue;
+				}
+
+				if (std::isspace(c))
+				{
+					if (!token.empty())
+						return token;
+					continue;
+				}
+
+				token.push_back(static_cast<char>(c));
+			}
+		}
+
+		image read_ppm(std::filesystem::path const & path)
+		{
+			std::ifstream input(path, std::ios::binary);
+
+			image result;
+
+			if (header_token(input) != "P6")
+				return result;
+
+			int const width = std::stoi(header_token(input));
+			int const height = std::stoi(header_token(input));
+			int const max_value = std::stoi(header_token(input));
+
+			if (width <= 0 || height <= 0 || max_value != 255)
+				return result;
+
+			std::vector<std::uint8_t> rgb(std::size_t(width) * height * 3);
+			if (!input.read(reinterpret_cast<char *>(rgb.data()), rgb.size()))
+				return result;
+
+			result.width = width;
+			result.height = height;
+			result.pixels.resize(std::size_t(width) * height * 4);
+			for (std::size_t i = 0, j = 0; i < rgb.size(); i += 3, j += 4)
+			{
+				result.pixels[j + 0] = rgb[i + 0];
+				result.pixels[j + 1] = rgb[i + 1];
+				result.pixels[j + 2] = rgb[i + 2];
+				result.pixels[j + 3] = 255;
+			}
+
+			return result;
+		}
+
+		void write_ppm(std::filesystem::path const & path, image const & source)
+		{
+			std::vector<std::uint8_t> rgb(std::size_t(source.width) * source.height * 3);
+			for (std::size_t i = 0, j = 0; i < rgb.size(); i += 3, j += 4)
+			{
+				rgb[i + 0] = source.pixels[j + 0];
+				rgb[i + 1] = source.pixels[j + 1];
+				rgb[i + 2] = source.pixels[j + 2];
+			}
+
+			std::ofstream output(path, std::ios::binary);
+			output << "P6\n" << source.width << " " << source.height << "\n255\n";
+			output.write(reinterpret_cast<char const *>(rgb.data()), rgb.size());
+		}
+
+		// Hands items over between threads in the order of their indices, whatever order
+		// they are produced in. Producers block while they are capacity or more items ahead
+		// of the consumer, which bounds the memory held by the queue
+		template <typename T>
+		struct ordered_queue
+		{
+			explicit ordered_queue(std::size_t capacity)
+				: capacity_(capacity)
+			{}
+
+			void push(std::size_t index, T value)
+			{
+				std::unique_lock lock{mutex_};
+				condition_.wait(lock, [&]{ return index < next_ + capacity_; });
+				items_.emplace(index, std::move(value));
+				condition_.notify_all();
+			}
+
+			T pop()
+			{
+				std::unique_lock lock{mutex_};
+				condition_.wait(lock, [&]{ return !items_.empty() && items_.begin()->first == next_; });
+				T value = std::move(items_.begin()->second);
+				items_.erase(items_.begin());
+				++next_;
+				condition_.notify_all();
+				return value;
+			}
+
+		private:
+			std::size_t capacity_;
+			std::size_t next_ = 0;
+			std::map<std::size_t, T> items_;
+			std::mutex mutex_;
+			std::condition_variable condition_;
+		};
+
+		// Number of images in flight between upload and readback, each one with its own
+		// pixel buffers and layer of the blur arrays
+		constexpr int ring_size = 3;
+
+		struct pipeline_slot
+		{
+			GLuint upload_buffer = 0;
+			GLuint readback_buffer = 0;
+
+			// Signalled once the readback into readback_buffer is complete
+			GLsync fence = nullptr;
+
+			bool busy = false;
+			std::size_t index = 0;
+			int width = 0;
+			int height = 0;
+		};
+
+		struct image_batch_impl
+			: scene
+		{
+			image_batch_impl(image_batch_options options);
+			~image_batch_impl();
+
+			void present() override;
+
+		private:
+			image_batch_options options_;
+
+			std::vector<std::filesystem::path> files_;
+
+			batch_blur blur_;
+
+			pipeline_slot slots_[ring_size];
+
+			bool finished_ = false;
+			std::vector<std::string> summary_;
+
+			gfx::painter & painter_ = services().painter;
+
+			double fence_wait_ = 0.0;
+
+			void run();
+
+			// Waits for the readback of the slot and passes the result on for encoding
+			void retire(pipeline_slot & slot, ordered_queue<image> & results);
+		};
+
+		image_batch_impl::image_batch_impl(image_batch_options options)
+			: options_(std::move(options))
+			, blur_(options_.sigma, options_.radius)
+		{
+			for (auto const & entry : std::filesystem::directory_iterator(options_.input))
+				if (entry.is_regular_file() && entry.path().extension() == ".ppm")
+					files_.push_back(entry.path());
+
+			std::sort(files_.begin(), files_.end());
+
+			std::filesystem::create_directories(options_.output);
+
+			for (auto & slot : slots_)
+			{
+				gl::GenBuffers(1, &slot.upload_buffer);
+				gl::GenBuffers(1, &slot.readback_buffer);
+			}
+		}
+
+		image_batch_impl::~image_batch_impl()
+		{
+			for (auto & slot : slots_)
+			{
+				if (slot.fence)
+					gl::DeleteSync(slot.fence);
+
+				gl::DeleteBuffers(1, &slot.upload_buffer);
+				gl::DeleteBuffers(1, &slot.readback_buffer);
+			}
+		}
+
+		void image_batch_impl::retire(pipeline_slot & slot, ordered_queue<image> & results)
+		{
+			auto const start = clock_type::now();
+
+			GLenum status;
+			while ((status = gl::ClientWaitSync(slot.fence, gl::SYNC_FLUSH_COMMANDS_BIT, 1000000)) == gl::TIMEOUT_EXPIRED)
+			{}
+
+			fence_wait_ += seconds_since(start);
+
+			gl::DeleteSync(slot.fence);
+			slot.fence = nullptr;
+			slot.busy = false;
+
+			image result;
+			result.width = slot.width;
+			result.height = slot.height;
+
+			// The buffer may not hold the blurred image yet, so the image fails instead
+			if (status == gl::WAIT_FAILED)
+			{
+				result.error = "waiting for the readback failed";
+				results.push(slot.index, std::move(result));
+				return;
+			}
+
+			std::size_t const bytes = std::size_t(slot.width) * slot.height * 4;
+
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, slot.readback_buffer);
+			if (auto mapped = gl::MapBufferRange(gl::PIXEL_PACK_BUFFER, 0, bytes, gl::MAP_READ_BIT))
+			{
+				result.pixels.resize(bytes);
+				std::memcpy(result.pixels.data(), mapped, bytes);
+
+				// The contents were lost while mapped, e.g. on a mode switch
+				if (!gl::UnmapBuffer(gl::PIXEL_PACK_BUFFER))
+				{
+					result.pixels.clear();
+					result.error = "the readback was corrupted";
+				}
+			}
+			else
+				result.error = "mapping the readback failed";
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+			results.push(slot.index, std::move(result));
+		}
+
+		void image_batch_impl::run()
+		{
+			finished_ = true;
+
+			if (files_.empty())
+			{
+				summary_.push_back(util::to_string("No .ppm images in ", options_.input.string()));
+				std::cout << summary_.back() << std::endl;
+				return;
+			}
+
+			auto const start = clock_type::now();
+
+			std::size_t const count = files_.size();
+
+			// Both queues are deeper than the ring, so the GL stage never blocks
+			// on handing over results that are ahead of the ones still in flight
+			ordered_queue<image> decoded(2 * ring_size + options_.threads);
+			ordered_queue<image> results(2 * ring_size);
+
+			std::atomic<std::size_t> next_file{0};
+			std::atomic<std::int64_t> decode_time{0};
+			std::atomic<std::int64_t> encode_time{0};
+			std::atomic<std::size_t> failed{0};
+
+			std::vector<std::thread> decoders;
+			for (int t = 0; t < options_.threads; ++t)
+			{
+				decoders.emplace_back([&]{
+					for (std::size_t i; (i = next_file++) < count;)
+					{
+						auto const decode_start = clock_type::now();
+
+						image decoded_image;
+						try
+						{
+							decoded_image = read_ppm(files_[i]);
+						}
+						catch (std::exception const &)
+						{}
+
+						if (decoded_image.pixels.empty())
+							decoded_image.error = "not a binary 8-bit PPM image";
+
+						decode_time += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - decode_start).count();
+						decoded.push(i, std::move(decoded_image));
+					}
+				});
+			}
+
+			std::thread encoder([&]{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					image result = results.pop();
+
+					auto const encode_start = clock_type::now();
+
+					if (result.pixels.empty())
+					{
+						std::cout << "Skipping " << files_[i].string() << ": " << result.error << std::endl;
+						++failed;
+					}
+					else
+						write_ppm(options_.output / files_[i].filename(), result);
+
+					encode_time += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - encode_start).count();
+				}
+			});
+
+			double decode_wait = 0.0;
+			fence_wait_ = 0.0;
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				auto const wait_start = clock_type::now();
+				image source = decoded.pop();
+				decode_wait += seconds_since(wait_start);
+
+				auto & slot = slots_[i % ring_size];
+				if (slot.busy)
+					retire(slot, results);
+
+				if (source.pixels.empty())
+				{
+					results.push(i, std::move(source));
+					continue;
+				}
+
+				// The arrays are reallocated when the image size changes,
+				// after the images still in flight are read back
+				if (source.width != blur_.width() || source.height != blur_.height())
+				{
+					for (auto & other : slots_)
+						if (other.busy)
+							retire(other, results);
+
+					blur_.resize(source.width, source.height, ring_size);
+				}
+
+				int const layer = i % ring_size;
+				std::size_t const bytes = source.pixels.size();
+
+				// Orphaning the buffer lets the driver hand out fresh storage
+				// instead of waiting for the previous upload from it
+				gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, slot.upload_buffer);
+				gl::BufferData(gl::PIXEL_UNPACK_BUFFER, bytes, nullptr, gl::STREAM_DRAW);
+				gl::BufferSubData(gl::PIXEL_UNPACK_BUFFER, 0, bytes, source.pixels.data());
+				blur_.upload(layer, nullptr);
+				gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+				blur_.apply(layer, 1);
+
+				gl::BindBuffer(gl::PIXEL_PACK_BUFFER, slot.readback_buffer);
+				gl::BufferData(gl::PIXEL_PACK_BUFFER, bytes, nullptr, gl::STREAM_READ);
+				blur_.download(layer, nullptr);
+				gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+				slot.fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+				gl::Flush();
+
+				slot.busy = true;
+				slot.index = i;
+				slot.width = source.width;
+				slot.height = source.height;
+			}
+
+			for (std::size_t i = count - std::min<std::size_t>(count, ring_size); i < count; ++i)
+			{
+				auto & slot = slots_[i % ring_size];
+				if (slot.busy)
+					retire(slot, results);
+			}
+
+			for (auto & decoder : decoders)
+				decoder.join();
+			encoder.join();
+
+			double const total = seconds_since(start);
+
+			summary_.push_back(util::to_string("Blurred ", count - failed, " of ", count, " images in ", total, "s, ", (count - failed) / total, " images/s"));
+			summary_.push_back(util::to_string("Decoding: ", decode_time / 1e9, "s over ", options_.threads, " threads, GL thread waited ", decode_wait, "s for it"));
+			summary_.push_back(util::to_string("GPU: GL thread waited ", fence_wait_, "s for readbacks"));
+			summary_.push_back(util::to_string("Encoding: ", encode_time / 1e9, "s"));
+			summary_.push_back(util::to_string("Results written to ", options_.output.string()));
+
+			for (auto const & line : summary_)
+				std::cout << line << std::endl;
+		}
+
+		void image_batch_impl::present()
+		{
+			if (!finished_)
+				run();
+
+			gfx::framebuffer::null().bind();
+			gl::Viewport(0, 0, width(), height());
+			gl::ClearColor(0.8f, 0.8f, 1.f, 0.f);
+			gl::Clear(gl::COLOR_BUFFER_BIT);
+
+			gfx::painter::text_options opts;
+			opts.scale = 2.f;
+			opts.c = gfx::black;
+			opts.x = gfx::painter::x_align::left;
+			opts.y = gfx::painter::y_align::top;
+
+			float y = 20.f;
+			for (auto const & line : summary_)
+			{
+				painter_.text({20.f, y}, line, opts);
+				y += 20.f;
+			}
+
+			painter_.render(geom::window_camera{width(), height()}.transform());
+		}
+
+	}
+
+	bool parse_image_batch_options(int argc, char ** argv, image_batch_options & options)
+	{
+		if (argc < 2 || std::string(argv[1]) != "--batch")
+			return false;
+
+		if (argc < 4)
+			throw std::runtime_error("Usage: blur --batch <input directory> <output directory> [--sigma S] [--radius R] [--threads N]");
+
+		options.input = argv[2];
+		options.output = argv[3];
+
+		for (int i = 4; i < argc; i += 2)
+		{
+			std::string const name = argv[i];
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			std::string const value = argv[i + 1];
+
+			if (name == "--sigma")
+				options.sigma = std::stof(value);
+			else if (name == "--radius")
+				options.radius = std::stoi(value);
+			else if (name == "--threads")
+				options.threads = std::max(1, std::stoi(value));
+			else
+				throw std::runtime_error(util::to_string("Unknown option ", name));
+		}
+
+		return true;
+	}
+
+	std::unique_ptr<scene> image_batch(image_batch_options options)
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<image_batch_impl>(std::move(options));
+	}
+
+}
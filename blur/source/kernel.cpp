@@ -0,0 +1,69 @@
+#include <compute/blur/kernel.hpp>
+
+#include <cmath>
+#include <sstream>
+
+namespace compute
+{
+
+	std::vector<float> gaussian_weights(float sigma, int radius)
+	{
+		std::vector<double> weights(2 * radius + 1);
+
+		double const scale = 1.0 / (std::sqrt(2.0) * sigma);
+
+		double sum = 0.0;
+		for (int i = -radius; i <= radius; ++i)
+		{
+			double const w = std::erf((i + 0.5) * scale) - std::erf((i - 0.5) * scale);
+			weights[i + radius] = w;
+			sum += w;
+		}
+
+		std::vector<float> result(weights.size());
+		for (std::size_t i = 0; i < weights.size(); ++i)
+			result[i] = static_cast<float>(weights[i] / sum);
+		return result;
+	}
+
+	namespace
+	{
+
+		void write_coefficients(std::ostringstream & os, std::vector<float> const & weights, std::size_t first)
+		{
+			os.precision(17);
+			for (std::size_t i = first; i < weights.size(); ++i)
+			{
+				os << "\t" << weights[i];
+				if (i + 1 < weights.size())
+					os << ",";
+				os << "\n";
+			}
+		}
+
+	}
+
+	std::string gaussian_kernel_source(float sigma, int radius)
+	{
+		std::ostringstream os;
+		os << "const int M = " << radius << ";\n";
+		os << "const int N = 2 * M + 1;\n\n";
+		os << "// sigma = " << sigma << "\n";
+		os << "const float coeffs[N] = float[N](\n";
+		write_coefficients(os, gaussian_weights(sigma, radius), 0);
+		os << ");\n";
+		return os.str();
+	}
+
+	std::string gaussian_half_kernel_source(float sigma, int radius)
+	{
+		std::ostringstream os;
+		os << "const int M = " << radius << ";\n\n";
+		os << "// sigma = " << sigma << "\n";
+		os << "const float coeffs[M + 1] = float[M + 1](\n";
+		write_coefficients(os, gaussian_weights(sigma, radius), radius);
+		os << ");\n";
+		return os.str();
+	}
+
+}
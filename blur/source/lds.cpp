@@ -0,0 +1,60 @@
+#include <compute/blur/lds.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/util/to_string.hpp>
+
+#include <stdexcept>
+
+namespace compute
+{
+
+	char const * lds_layout_name(lds_layout layout)
+	{
+		switch (layout)
+		{
+		case lds_layout::column: return "column";
+		case lds_layout::column_padded: return "column padded";
+		case lds_layout::row: return "row";
+		}
+		return "unknown";
+	}
+
+	std::string lds_cache_source(lds_layout layout, pixel_format storage)
+	{
+		char const * stride = (layout == lds_layout::column_padded) ? "(CACHE_SIZE + 1)" : "CACHE_SIZE";
+		char const * index = (layout == lds_layout::row) ? "((p).y * CACHE_STRIDE + (p).x)" : "((p).x * CACHE_STRIDE + (p).y)";
+
+		return util::to_string(
+			pixel_format_packing_source(storage), "\n",
+			"#define CACHE_STRIDE ", stride, "\n",
+			"#define cache_index(p) ", index, "\n",
+			"#define cache_store(p, v) cache[cache_index(p)] = pack_lds(v)\n",
+			"#define cache_load(p) unpack_lds(cache[cache_index(p)])\n\n");
+	}
+
+	pixel_format next_lds_storage(pixel_format storage)
+	{
+		switch (storage)
+		{
+		case pixel_format::rgba32f: return pixel_format::rgba16f;
+		case pixel_format::rgba16f: return pixel_format::rgba8;
+		default: return pixel_format::rgba32f;
+		}
+	}
+
+	int lds_cache_bytes(lds_layout layout, pixel_format storage, int cache_size)
+	{
+		int const stride = (layout == lds_layout::column_padded) ? cache_size + 1 : cache_size;
+		return cache_size * stride * pixel_format_bytes(storage);
+	}
+
+	void check_lds_size(int bytes)
+	{
+		GLint max_size = 0;
+		gl::GetIntegerv(gl::MAX_COMPUTE_SHARED_MEMORY_SIZE, &max_size);
+
+		if (bytes > max_size)
+			throw std::runtime_error(util::to_string("Shared memory tile of ", bytes, " bytes exceeds the limit of ", max_size, " bytes"));
+	}
+
+}
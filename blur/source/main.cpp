@@ -2,12 +2,27 @@
 #include <psemek/app/main.hpp>
 
 #include <compute/blur/scene.hpp>
+#include <compute/blur/image_batch.hpp>
+#include <compute/blur/tiled.hpp>
+#include <compute/blur/adaptive.hpp>
+#include <compute/blur/compare.hpp>
+#include <compute/blur/telemetry.hpp>
+
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
 
 namespace compute
 {
 
 	using namespace psemek;
 
+	// Set by main if the command line requests the batch, the tiled or the adaptive mode
+	std::optional<image_batch_options> batch_options;
+	std::optional<tiled_options> tiled_mode_options;
+	std::optional<adaptive_options> adaptive_mode_options;
+
 	struct blur_app
 		: app::app
 	{
@@ -15,13 +30,78 @@ namespace compute
 			: app::app("Blur", 0)
 		{
 			vsync(false);
-			push_scene(default_scene());
+
+			if (batch_options)
+				push_scene(image_batch(*batch_options));
+			else if (tiled_mode_options)
+				push_scene(tiled(*tiled_mode_options));
+			else if (adaptive_mode_options)
+				push_scene(adaptive(*adaptive_mode_options));
+			else
+				push_scene(default_scene());
 		}
 	};
 
 }
 
-int main()
+int main(int argc, char ** argv)
 {
+	try
+	{
+		// Options that combine with every mode come first, the rest select the mode by argv[1]
+		compute::replay_options replay;
+		if (compute::parse_replay_options(argc, argv, replay))
+			compute::set_replay_options(replay);
+
+		compute::throughput_peak peak;
+		if (compute::parse_peak_options(argc, argv, peak))
+			compute::set_peak(peak);
+
+		// Comparing result files needs no window, the exit status gates on regressions
+		compute::compare_options compare;
+		if (compute::parse_compare_options(argc, argv, compare))
+			return compute::compare_results(compare, std::cout) > 0 ? 2 : 0;
+
+		compute::monitor_options monitor;
+		if (compute::parse_monitor_options(argc, argv, monitor))
+		{
+			compute::run_monitor(monitor, std::cout);
+			return 0;
+		}
+
+		compute::image_batch_options options;
+		if (compute::parse_image_batch_options(argc, argv, options))
+			compute::batch_options = std::move(options);
+
+		compute::tiled_options tiled;
+		if (compute::parse_tiled_options(argc, argv, tiled))
+			compute::tiled_mode_options = std::move(tiled);
+
+		compute::adaptive_options adaptive;
+		if (compute::parse_adaptive_options(argc, argv, adaptive))
+		{
+			compute::set_adaptive_options(adaptive);
+			compute::adaptive_mode_options = adaptive;
+		}
+
+		if (argc > 1 && !compute::batch_options && !compute::tiled_mode_options && !compute::adaptive_mode_options)
+			throw std::runtime_error(std::string("Unknown mode ") + argv[1]);
+	}
+	catch (std::exception const & e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	// Monitoring is optional, the renderer runs without it
+	try
+	{
+		compute::start_telemetry();
+	}
+	catch (std::exception const & e)
+	{
+		std::cerr << "Telemetry disabled: " << e.what() << std::endl;
+	}
+
 	return psemek::app::main<compute::blur_app>();
 }
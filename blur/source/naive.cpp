@@ -1,4 +1,7 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
 
 #include <psemek/gfx/array.hpp>
 #include <psemek/gfx/program.hpp>
@@ -10,7 +13,6 @@
 #include <psemek/gfx/query.hpp>
 #include <psemek/geom/camera.hpp>
 #include <psemek/util/clock.hpp>
-#include <psemek/util/to_string.hpp>
 #include <psemek/util/moving_average.hpp>
 
 namespace compute
@@ -122,16 +124,18 @@ void main()
 			gfx::texture_2d color_buffer_;
 			gfx::renderbuffer depth_buffer_;
 
-			gfx::program blur_program_{naive_vertex, naive_fragment};
+			shared_program blur_program_ = services().program(naive_vertex, naive_fragment);
 
-			gfx::array vao_;
+			gfx::array & vao_ = services().fullscreen_vao;
 
-			gfx::painter painter_;
+			gfx::painter & painter_ = services().painter;
 
 			gfx::query_pool queries_;
 
 			util::moving_average<float> frame_time_{32};
 			util::moving_average<float> blur_time_{32};
+
+			blur_traffic traffic() const;
 		};
 
 		naive_impl::naive_impl()
@@ -151,12 +155,23 @@ void main()
 			fbo_.depth(depth_buffer_);
 
 			fbo_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic naive_impl::traffic() const
+		{
+			// The kernel is fixed at M = 16
+			int const n = 33;
+
+			return direct_pass(width(), height(), n * n, 4, 4, n * n);
 		}
 
 		void naive_impl::present()
 		{
 			float const dt = clock_.restart().count();
 			frame_time_.push(dt);
+			begin_frame(dt);
 
 			fbo_.bind();
 			scene::draw();
@@ -173,11 +188,15 @@ void main()
 			vao_.bind();
 
 			{
-				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); });
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
 				gl::DrawArrays(gl::TRIANGLES, 0, 3);
 			}
 
 			{
+				profile_scope const hud_scope{"hud text"};
+
 				gfx::painter::text_options opts;
 				opts.scale = 2.f;
 				opts.c = gfx::black;
@@ -186,15 +205,24 @@ void main()
 
 				painter_.text({20.f, 20.f}, "Naive", opts);
 
-				painter_.text({20.f, 40.f}, util::to_string("FPS: ", 1.f / frame_time_.average()), opts);
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
 
 				if (blur_time_.count() > 0)
-					painter_.text({20.f, 60.f}, util::to_string("Blur: ", blur_time_.average(), "ms"), opts);
+				{
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 80.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+				}
 			}
 
-			painter_.render(geom::window_camera{width(), height()}.transform());
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
 
-			queries_.poll();
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
 		}
 
 	}
@@ -204,4 +232,16 @@ void main()
 		return std::make_unique<naive_impl>();
 	}
 
+	namespace
+	{
+
+		variant_registrar const naive_registrar{{
+			.name = "naive",
+			.factory = naive,
+			.key = SDLK_1,
+			.reference_output = true,
+		}};
+
+	}
+
 }
@@ -0,0 +1,190 @@
+#include <compute/blur/profiler.hpp>
+
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace compute
+{
+
+	namespace profiler_detail
+	{
+
+		std::atomic<bool> enabled{false};
+
+	}
+
+	namespace
+	{
+
+		using profiler_detail::clock_type;
+
+		struct event
+		{
+			char const * name;
+			clock_type::time_point begin;
+			clock_type::time_point end;
+			bool gpu;
+		};
+
+		// Written by its thread only. The count is published with release semantics after
+		// the event itself, so the exporting thread sees complete events only
+		struct thread_buffer
+		{
+			static constexpr std::size_t capacity = 1 << 16;
+
+			int thread_index;
+			std::atomic<unsigned> epoch{0};
+			std::atomic<std::size_t> count{0};
+			std::array<event, capacity> events;
+		};
+
+		// Start times of the GPU query scopes of a thread whose results haven't arrived yet.
+		// Kept apart from the event buffer and across recordings
+		struct query_ring
+		{
+			static constexpr std::size_t capacity = 64;
+
+			std::array<clock_type::time_point, capacity> times;
+			std::size_t begin = 0;
+			std::size_t end = 0;
+		};
+
+		thread_local query_ring queries;
+
+		std::atomic<unsigned> current_epoch{0};
+		clock_type::time_point epoch_start = clock_type::now();
+
+		// Buffers outlive their threads, so a recording can be exported after the threads exit
+		std::mutex buffers_mutex;
+		std::vector<std::unique_ptr<thread_buffer>> buffers;
+
+		thread_buffer & local_buffer()
+		{
+			thread_local thread_buffer * buffer = []
+			{
+				std::lock_guard lock{buffers_mutex};
+				buffers.push_back(std::make_unique<thread_buffer>());
+				buffers.back()->thread_index = static_cast<int>(buffers.size());
+				return buffers.back().get();
+			}();
+
+			// The thread resets its own buffer when a new recording starts
+			unsigned const epoch = current_epoch.load(std::memory_order_acquire);
+			if (buffer->epoch.load(std::memory_order_relaxed) != epoch)
+			{
+				buffer->count.store(0, std::memory_order_relaxed);
+				buffer->epoch.store(epoch, std::memory_order_release);
+			}
+
+			return *buffer;
+		}
+
+		void push(thread_buffer & buffer, event const & e)
+		{
+			std::size_t const count = buffer.count.load(std::memory_order_relaxed);
+			if (count == thread_buffer::capacity)
+				return;
+
+			buffer.events[count] = e;
+			buffer.count.store(count + 1, std::memory_order_release);
+		}
+
+		double microseconds(clock_type::time_point time)
+		{
+			return std::chrono::duration<double, std::micro>(time - epoch_start).count();
+		}
+
+	}
+
+	namespace profiler_detail
+	{
+
+		void record(char const * name, clock_type::time_point begin, clock_type::time_point end)
+		{
+			push(local_buffer(), {name, begin, end, false});
+		}
+
+		// Once the ring is full the oldest query is forgotten, as its result would be
+		// too late to matter anyway
+		void query_issued(clock_type::time_point time)
+		{
+			if (queries.end - queries.begin == query_ring::capacity)
+				++queries.begin;
+
+			queries.times[queries.end++ % query_ring::capacity] = time;
+		}
+
+	}
+
+	void profile_gpu(char const * name, float ms)
+	{
+		if (queries.begin == queries.end)
+			return;
+
+		auto const begin = queries.times[queries.begin++ % query_ring::capacity];
+
+		if (!profiling())
+			return;
+
+		auto const end = begin + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<float, std::milli>(ms));
+		push(local_buffer(), {name, begin, end, true});
+	}
+
+	void profile_discard_queries()
+	{
+		queries.begin = queries.end;
+	}
+
+	void start_profiling()
+	{
+		epoch_start = clock_type::now();
+		current_epoch.fetch_add(1, std::memory_order_acq_rel);
+		profiler_detail::enabled.store(true, std::memory_order_release);
+	}
+
+	std::size_t stop_profiling(std::filesystem::path const & path)
+	{
+		profiler_detail::enabled.store(false, std::memory_order_release);
+
+		std::ofstream output(path);
+		if (!output)
+			throw std::runtime_error("Failed to open " + path.string());
+
+		// GPU events of all threads share one track
+		int const gpu_track = 0;
+
+		output << "{\"traceEvents\":[\n";
+		output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpu_track << ",\"args\":{\"name\":\"GPU\"}}";
+
+		std::size_t written = 0;
+		unsigned const epoch = current_epoch.load(std::memory_order_acquire);
+
+		std::lock_guard lock{buffers_mutex};
+		for (auto const & buffer : buffers)
+		{
+			output << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_index << ",\"args\":{\"name\":\"Thread " << buffer->thread_index << "\"}}";
+
+			if (buffer->epoch.load(std::memory_order_acquire) != epoch)
+				continue;
+
+			std::size_t const count = buffer->count.load(std::memory_order_acquire);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				auto const & e = buffer->events[i];
+				output << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e.gpu ? gpu_track : buffer->thread_index)
+					<< ",\"ts\":" << microseconds(e.begin) << ",\"dur\":" << std::chrono::duration<double, std::micro>(e.end - e.begin).count() << "}";
+				++written;
+			}
+		}
+
+		output << "\n]}\n";
+
+		return written;
+	}
+
+}
@@ -0,0 +1,113 @@
+#include <compute/blur/registry.hpp>
+
+#include <psemek/gfx/gl.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		std::vector<variant_info> & registry()
+		{
+			static std::vector<variant_info> instance;
+			return instance;
+		}
+
+	}
+
+	bool requirements_met(unsigned requirements)
+	{
+		if ((requirements & requires_compute_shader) && !gl::sys::ext_ARB_compute_shader())
+			return false;
+
+		if ((requirements & requires_image_load_store) && !gl::sys::ext_ARB_shader_image_load_store())
+			return false;
+
+		if ((requirements & requires_buffer_storage) && !gl::sys::ext_ARB_buffer_storage())
+			return false;
+
+		if (requirements & requires_subgroup_shuffle)
+		{
+			if (!gl::sys::ext_KHR_shader_subgroup())
+				return false;
+
+			GLint stages = 0;
+			GLint features = 0;
+			GLint subgroup_size = 0;
+
+			gl::GetIntegerv(gl::SUBGROUP_SUPPORTED_STAGES_KHR, &stages);
+			gl::GetIntegerv(gl::SUBGROUP_SUPPORTED_FEATURES_KHR, &features);
+			gl::GetIntegerv(gl::SUBGROUP_SIZE_KHR, &subgroup_size);
+
+			if (!(stages & gl::COMPUTE_SHADER_BIT) || !(features & gl::SUBGROUP_FEATURE_SHUFFLE_BIT_KHR))
+				return false;
+
+			if (subgroup_size <= 0 || 64 % subgroup_size != 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	std::string requirement_names(unsigned requirements)
+	{
+		std::string result;
+
+		auto add = [&](char const * name)
+		{
+			if (!result.empty())
+				result += ", ";
+			result += name;
+		};
+
+		if (requirements & requires_compute_shader)
+			add("ARB_compute_shader");
+		if (requirements & requires_image_load_store)
+			add("ARB_shader_image_load_store");
+		if (requirements & requires_buffer_storage)
+			add("ARB_buffer_storage");
+		if (requirements & requires_subgroup_shuffle)
+			add("KHR_shader_subgroup (shuffle)");
+
+		return result;
+	}
+
+	bool radius_supported(variant_info const & variant, int radius)
+	{
+		return !variant.max_radius || radius <= variant.max_radius();
+	}
+
+	void register_variant(variant_info info)
+	{
+		auto & variants = registry();
+
+		if (find_variant(info.name))
+			throw std::logic_error("Variant " + info.name + " registered twice");
+
+		if (info.key != SDLK_UNKNOWN)
+			for (auto const & other : variants)
+				if (other.key == info.key)
+					throw std::logic_error("Variants " + other.name + " and " + info.name + " have the same key");
+
+		auto position = std::lower_bound(variants.begin(), variants.end(), info.name, [](variant_info const & v, std::string const & name){ return v.name < name; });
+		variants.insert(position, std::move(info));
+	}
+
+	std::vector<variant_info> const & variants()
+	{
+		return registry();
+	}
+
+	variant_info const * find_variant(std::string const & name)
+	{
+		for (auto const & variant : registry())
+			if (variant.name == name)
+				return &variant;
+		return nullptr;
+	}
+
+}
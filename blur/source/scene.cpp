@@ -1,4 +1,8 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+#include <compute/blur/telemetry.hpp>
 
 #include <psemek/app/app.hpp>
 #include <psemek/gfx/gl.hpp>
@@ -14,19 +18,79 @@
 #include <psemek/random/generator.hpp>
 #include <psemek/random/uniform.hpp>
 #include <psemek/random/uniform_sphere.hpp>
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
 
 namespace compute
 {
 
 	std::unique_ptr<scene> naive();
-	std::unique_ptr<scene> separable();
-	std::unique_ptr<scene> separable_linear();
-	std::unique_ptr<scene> compute();
-	std::unique_ptr<scene> compute_lds();
-	std::unique_ptr<scene> compute_separable();
-	std::unique_ptr<scene> compute_separable_lds();
-	std::unique_ptr<scene> compute_separable_single_lds();
-	std::unique_ptr<scene> compute_separable_lds_compact();
+	std::unique_ptr<scene> benchmark();
+	std::unique_ptr<scene> hybrid();
+
+	namespace
+	{
+
+		char const trace_output_path[] = "blur_trace.json";
+
+		std::optional<replay_options> current_replay_options;
+
+	}
+
+	bool parse_replay_options(int & argc, char ** argv, replay_options & options)
+	{
+		bool deterministic = false;
+		bool parameters = false;
+		int kept = 1;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string const name = argv[i];
+
+			if (name == "--deterministic")
+			{
+				deterministic = true;
+				continue;
+			}
+
+			if (name != "--seed" && name != "--timestep")
+			{
+				argv[kept++] = argv[i];
+				continue;
+			}
+
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			std::string const value = argv[++i];
+
+			if (name == "--seed")
+				options.seed = std::stoull(value);
+			else
+				options.timestep = std::stof(value);
+
+			parameters = true;
+		}
+
+		argc = kept;
+
+		if (parameters && !deterministic)
+			throw std::runtime_error("--seed and --timestep require --deterministic");
+
+		if (!(options.timestep > 0.f))
+			throw std::runtime_error("Timestep must be positive");
+
+		return deterministic;
+	}
+
+	void set_replay_options(replay_options options)
+	{
+		current_replay_options = options;
+	}
 
 	static char const simple_vertex[] =
 R"(#version 330
@@ -85,6 +149,22 @@ void main()
 		bool paused = false;
 		float time = 0.f;
 
+		std::optional<replay_options> replay = current_replay_options;
+		std::uint64_t frame_index = 0;
+
+		std::function<void(float)> blur_time_listener;
+		std::function<void(blur_traffic const &)> traffic_listener;
+		std::function<void()> output_listener;
+
+		int render_scale = 1;
+		int kernel_radius = 16;
+		pixel_format intermediate_format = pixel_format::rgba8;
+
+		allocation_counters frame_start = allocation_count();
+		allocation_counters frame_allocations;
+
+		renderer_services services;
+
 		gfx::program simple_program{simple_vertex, simple_fragment};
 		gfx::mesh cube_mesh;
 
@@ -142,7 +222,7 @@ void main()
 			camera.axes[1] = {0.f, 1.f, 0.f};
 			camera.axes[2] = {0.f, 0.f, 1.f};
 
-			random::generator rng;
+			random::generator rng = replay ? random::generator{replay->seed} : random::generator{};
 			random::uniform_sphere_vector_distribution<float, 3> random_unit_vector;
 
 			int const count = 5;
@@ -174,9 +254,12 @@ void main()
 		}
 	};
 
+	// A new scene replaces the current one, whose pending timer queries are dropped with it
 	scene::scene()
 		: pimpl_(impl::instance())
-	{}
+	{
+		profile_discard_queries();
+	}
 
 	scene::~scene() = default;
 
@@ -191,57 +274,88 @@ void main()
 	{
 		app::scene_base::on_key_down(key);
 
-		if (key == SDLK_1)
+		if (key == SDLK_b)
 		{
-			replace_with(naive());
+			replace_with(benchmark);
 		}
-		else if (key == SDLK_2)
+		else if (key != SDLK_UNKNOWN)
 		{
-			replace_with(separable());
-		}
-		else if (key == SDLK_3)
-		{
-			replace_with(separable_linear());
-		}
-		else if (key == SDLK_4)
-		{
-			replace_with(compute());
-		}
-		else if (key == SDLK_5)
-		{
-			replace_with(compute_lds());
-		}
-		else if (key == SDLK_6)
-		{
-			replace_with(compute_separable());
+			for (auto const & variant : variants())
+			{
+				if (variant.key == key)
+				{
+					replace_with([&variant]() -> std::unique_ptr<scene> {
+						// The hybrid blur only needs what drawing the scene does
+						try
+						{
+							return variant.factory();
+						}
+						catch (std::exception const & e)
+						{
+							std::cout << variant.name << " is not available (" << e.what() << "), using the hybrid CPU and GPU blur instead" << std::endl;
+							return hybrid();
+						}
+					});
+					break;
+				}
+			}
 		}
-		else if (key == SDLK_7)
+
+		if (key == SDLK_F2)
 		{
-			replace_with(compute_separable_lds());
+			if (!profiling())
+			{
+				start_profiling();
+				std::cout << "Profiling started" << std::endl;
+			}
+			else
+			{
+				try
+				{
+					auto const events = stop_profiling(trace_output_path);
+					std::cout << "Profile of " << events << " events written to " << trace_output_path << std::endl;
+				}
+				catch (std::exception const & e)
+				{
+					std::cout << "Failed to write the profile: " << e.what() << std::endl;
+				}
+			}
 		}
-		else if (key == SDLK_8)
+
+		if (key == SDLK_SPACE)
 		{
-			replace_with(compute_separable_single_lds());
+			pimpl_->paused = !pimpl_->paused;
 		}
-		else if (key == SDLK_9)
+
+		if (key == SDLK_r)
 		{
-			replace_with(compute_separable_lds_compact());
+			set_render_scale(render_scale() == 4 ? 1 : render_scale() * 2);
+			on_resize(width(), height());
 		}
 
-		if (key == SDLK_SPACE)
+		if (key == SDLK_f)
 		{
-			pimpl_->paused = !pimpl_->paused;
+			set_intermediate_format(static_cast<pixel_format>((static_cast<int>(intermediate_format()) + 1) % intermediate_format_count));
+			on_resize(width(), height());
 		}
 	}
 
 	void scene::draw()
 	{
+		profile_scope const scope{"scene draw"};
+
 		gl::Viewport(0, 0, width(), height());
 
 		float const dt = pimpl_->clock.restart().count();
 
 		if (!pimpl_->paused)
+		{
+			++pimpl_->frame_index;
 			pimpl_->time += dt;
+		}
+
+		if (pimpl_->replay)
+			pimpl_->time = pimpl_->frame_index * pimpl_->replay->timestep;
 
 		gl::ClearColor(0.8f, 0.8f, 1.f, 0.f);
 		gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
@@ -270,11 +384,168 @@ void main()
 		}
 	}
 
-	void scene::replace_with(std::unique_ptr<scene> new_scene)
+	void scene::begin_frame(float dt)
+	{
+		publish_telemetry(telemetry_kind::frame, dt * 1000.f);
+
+		auto const now = allocation_count();
+		pimpl_->frame_allocations = now - pimpl_->frame_start;
+		pimpl_->frame_start = now;
+
+		reset_frame_text();
+
+		gfx::painter::text_options opts;
+		opts.scale = 2.f;
+		opts.c = gfx::black;
+		opts.x = gfx::painter::x_align::left;
+		opts.y = gfx::painter::y_align::bottom;
+
+		services().painter.text({20.f, height() - 20.f}, frame_text("Allocations: ", pimpl_->frame_allocations.count, " per frame, ", pimpl_->frame_allocations.bytes, " bytes"), opts);
+	}
+
+	allocation_counters scene::frame_allocations() const
+	{
+		return pimpl_->frame_allocations;
+	}
+
+	void scene::report_blur_time(float ms)
+	{
+		profile_gpu("blur", ms);
+		publish_telemetry(telemetry_kind::blur, ms);
+
+		if (pimpl_->blur_time_listener)
+			pimpl_->blur_time_listener(ms);
+	}
+
+	void scene::set_blur_time_listener(std::function<void(float)> listener)
+	{
+		pimpl_->blur_time_listener = std::move(listener);
+	}
+
+	void scene::report_traffic(blur_traffic const & traffic)
+	{
+		if (pimpl_->traffic_listener)
+			pimpl_->traffic_listener(traffic);
+	}
+
+	void scene::set_traffic_listener(std::function<void(blur_traffic const &)> listener)
+	{
+		pimpl_->traffic_listener = std::move(listener);
+	}
+
+	void scene::output_ready()
+	{
+		if (pimpl_->output_listener)
+			pimpl_->output_listener();
+	}
+
+	void scene::set_output_listener(std::function<void()> listener)
+	{
+		pimpl_->output_listener = std::move(listener);
+	}
+
+	bool scene::paused() const
+	{
+		return pimpl_->paused;
+	}
+
+	void scene::set_paused(bool paused)
+	{
+		pimpl_->paused = paused;
+	}
+
+	bool scene::deterministic() const
+	{
+		return pimpl_->replay.has_value();
+	}
+
+	std::uint64_t scene::frame_index() const
+	{
+		return pimpl_->frame_index;
+	}
+
+	void scene::set_frame_index(std::uint64_t index)
+	{
+		pimpl_->frame_index = index;
+	}
+
+	int scene::render_scale() const
+	{
+		return pimpl_->render_scale;
+	}
+
+	void scene::set_render_scale(int scale)
+	{
+		pimpl_->render_scale = scale;
+	}
+
+	int scene::scaled_width() const
+	{
+		return std::max(1, width() / pimpl_->render_scale);
+	}
+
+	int scene::scaled_height() const
+	{
+		return std::max(1, height() / pimpl_->render_scale);
+	}
+
+	pixel_format scene::intermediate_format() const
+	{
+		return pimpl_->intermediate_format;
+	}
+
+	void scene::set_intermediate_format(pixel_format format)
+	{
+		pimpl_->intermediate_format = format;
+	}
+
+	// The reference kernel is sigma = 10 truncated at 16 pixels
+	float scene::blur_sigma() const
+	{
+		return 10.f / pimpl_->render_scale;
+	}
+
+	int scene::blur_radius() const
+	{
+		return std::max(1, pimpl_->kernel_radius / pimpl_->render_scale);
+	}
+
+	int scene::kernel_radius() const
+	{
+		return pimpl_->kernel_radius;
+	}
+
+	void scene::set_kernel_radius(int radius)
+	{
+		pimpl_->kernel_radius = radius;
+	}
+
+	void scene::replace_with(std::function<std::unique_ptr<scene>()> factory)
 	{
 		auto app = parent();
-		auto self = app->pop_scene();
-		app->push_scene(std::move(new_scene));
+
+		// Keeps the state shared by the scenes alive while there is none
+		auto const shared = pimpl_;
+
+		app->pop_scene().reset();
+
+		std::unique_ptr<scene> next;
+		try
+		{
+			next = factory();
+		}
+		catch (std::exception const & e)
+		{
+			std::cout << "Failed to create the scene (" << e.what() << "), using the default one instead" << std::endl;
+			next = default_scene();
+		}
+
+		app->push_scene(std::move(next));
+	}
+
+	renderer_services & scene::services() const
+	{
+		return pimpl_->services;
 	}
 
 	std::unique_ptr<scene> default_scene()
@@ -0,0 +1,320 @@
+#include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
+
+#include <psemek/gfx/array.hpp>
+#include <psemek/gfx/program.hpp>
+#include <psemek/gfx/framebuffer.hpp>
+#include <psemek/gfx/texture.hpp>
+#include <psemek/gfx/renderbuffer.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/gfx/error.hpp>
+#include <psemek/gfx/query.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/clock.hpp>
+#include <psemek/util/to_string.hpp>
+#include <psemek/util/moving_average.hpp>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		char const separable_gather_vertex[] =
+R"(#version 330
+
+const vec2 vertices[3] = vec2[3](
+	vec2(-1.0, -1.0),
+	vec2( 3.0, -1.0),
+	vec2(-1.0,  3.0)
+);
+
+out vec2 texcoord;
+
+void main()
+{
+	vec2 vertex = vertices[gl_VertexID];
+	gl_Position = vec4(vertex, 0.0, 1.0);
+
+	texcoord = 0.5 * vertex + vec2(0.5);
+}
+)";
+
+		// M, N and coeffs are prepended by make_program
+
+		// Each set of four gathers (one per channel) fetches the 2x2 block of texels around
+		// a texel corner, covering two consecutive taps. Only one row (or column) of the block
+		// belongs to the pixel being shaded, so half of the fetched texels are wasted
+		char const separable_gather_fragment[] =
+R"(
+uniform sampler2D u_input_texture;
+uniform vec2 u_texel;
+uniform ivec2 u_direction;
+
+layout (location = 0) out vec4 out_color;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	vec4 sum = vec4(0.0);
+
+	for (int i = 0; i < N; i += 2)
+	{
+		// The corner after the tap texel in both directions, so the block spans
+		// the tap, the next tap and the next row (or column). The texture clamps
+		// the texels outside of the image to its edge
+		vec2 tc = vec2(pixel + u_direction * (i - M) + ivec2(1, 1)) * u_texel;
+
+		vec4 r = textureGather(u_input_texture, tc, 0);
+		vec4 g = textureGather(u_input_texture, tc, 1);
+		vec4 b = textureGather(u_input_texture, tc, 2);
+		vec4 a = textureGather(u_input_texture, tc, 3);
+
+		float w0 = coeffs[i];
+		float w1 = (i + 1 < N) ? coeffs[i + 1] : 0.0;
+
+		// Gather returns the texels in the order (0, 1), (1, 1), (1, 0), (0, 0)
+		vec4 tap0 = vec4(r.w, g.w, b.w, a.w);
+		vec4 tap1 = (u_direction.x == 1) ? vec4(r.z, g.z, b.z, a.z) : vec4(r.x, g.x, b.x, a.x);
+
+		sum += w0 * tap0 + w1 * tap1;
+	}
+
+	out_color = sum;
+}
+)";
+
+		struct separable_gather_impl
+			: scene
+		{
+			separable_gather_impl();
+
+			void on_resize(int width, int height) override;
+
+			void present() override;
+
+		private:
+			util::clock<std::chrono::duration<float>, std::chrono::high_resolution_clock> clock_;
+
+			gfx::framebuffer fbo_1_;
+			gfx::texture_2d color_buffer_1_;
+			gfx::renderbuffer depth_buffer_1_;
+
+			gfx::framebuffer fbo_2_;
+			gfx::texture_2d color_buffer_2_;
+
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			shared_program blur_program_;
+
+			gfx::array & vao_ = services().fullscreen_vao;
+
+			gfx::painter & painter_ = services().painter;
+
+			gfx::query_pool queries_;
+
+			util::moving_average<float> frame_time_{32};
+			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_ = pixel_format::rgba8;
+
+			shared_program make_program(char const * body) const;
+
+			blur_traffic traffic() const;
+		};
+
+		separable_gather_impl::separable_gather_impl()
+			: blur_program_{make_program(separable_gather_fragment)}
+			, kernel_radius_{blur_radius()}
+		{
+			color_buffer_1_.nearest_filter();
+			color_buffer_1_.clamp();
+
+			color_buffer_2_.nearest_filter();
+			color_buffer_2_.clamp();
+
+			color_buffer_3_.nearest_filter();
+			color_buffer_3_.clamp();
+		}
+
+		shared_program separable_gather_impl::make_program(char const * body) const
+		{
+			return services().program(separable_gather_vertex, util::to_string("#version 400\n\n", gaussian_kernel_source(blur_sigma(), blur_radius()), body));
+		}
+
+		void separable_gather_impl::on_resize(int width, int height)
+		{
+			scene::on_resize(width, height);
+
+			if (kernel_radius_ != blur_radius())
+			{
+				kernel_radius_ = blur_radius();
+				blur_program_ = make_program(separable_gather_fragment);
+			}
+
+			color_buffer_1_.load<gfx::color_rgba>({width, height});
+			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
+
+			downsampler_.resize(width, height, render_scale());
+
+			format_ = intermediate_format();
+			load(color_buffer_2_, format_, scaled_width(), scaled_height());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
+
+			fbo_1_.color(color_buffer_1_);
+			fbo_1_.depth(depth_buffer_1_);
+
+			fbo_2_.color(color_buffer_2_);
+
+			fbo_3_.color(color_buffer_3_);
+
+			fbo_1_.assert_complete();
+			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic separable_gather_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// M + 1 sets of four gathers, each set reading a 2x2 block of whole texels
+			blur_traffic traffic = direct_pass(scaled_width(), scaled_height(), 4 * (m + 1), 4, bytes, n);
+			traffic += direct_pass(scaled_width(), scaled_height(), 4 * (m + 1), bytes, 4, n);
+			return traffic;
+		}
+
+		void separable_gather_impl::present()
+		{
+			float const dt = clock_.restart().count();
+			frame_time_.push(dt);
+			begin_frame(dt);
+
+			fbo_1_.bind();
+			scene::draw();
+
+			{
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
+
+				fbo_2_.bind();
+				gl::Viewport(0, 0, scaled_width(), scaled_height());
+
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+				gl::Disable(gl::DEPTH_TEST);
+
+				blur_program_.bind();
+				blur_program_["u_input_texture"] = 0;
+				blur_program_["u_texel"] = geom::vector{1.f / scaled_width(), 1.f / scaled_height()};
+				blur_program_["u_direction"] = geom::vector{1, 0};
+				input.bind(0);
+				vao_.bind();
+
+				gl::DrawArrays(gl::TRIANGLES, 0, 3);
+
+				// At reduced resolution the vertical pass goes to an
+				// intermediate buffer which is then upsampled to the screen
+				if (render_scale() > 1)
+					fbo_3_.bind();
+				else
+					gfx::framebuffer::null().bind();
+
+				gl::Clear(gl::COLOR_BUFFER_BIT);
+
+				color_buffer_2_.bind(0);
+				blur_program_["u_direction"] = geom::vector{0, 1};
+
+				gl::DrawArrays(gl::TRIANGLES, 0, 3);
+
+				if (render_scale() > 1)
+				{
+					gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+					gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+					gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, gl::LINEAR);
+
+					gfx::framebuffer::null().bind();
+				}
+
+				gl::Viewport(0, 0, width(), height());
+			}
+
+			output_ready();
+
+			{
+				profile_scope const hud_scope{"hud text"};
+
+				gfx::painter::text_options opts;
+				opts.scale = 2.f;
+				opts.c = gfx::black;
+				opts.x = gfx::painter::x_align::left;
+				opts.y = gfx::painter::y_align::top;
+
+				painter_.text({20.f, 20.f}, "Separable gather", opts);
+
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
+
+				painter_.text({20.f, 120.f}, frame_text("Fetches per pixel and pass: ", 4 * (blur_radius() + 1), " gathers (per-tap: ", 2 * blur_radius() + 1, ")"), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 140.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
+			}
+
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
+
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
+		}
+
+	}
+
+	std::unique_ptr<scene> separable_gather()
+	{
+		return std::make_unique<separable_gather_impl>();
+	}
+
+	namespace
+	{
+
+		variant_registrar const separable_gather_registrar{{
+			.name = "separable_gather",
+			.factory = separable_gather,
+			.key = SDLK_i,
+			.passes = 2,
+			.scalable = true,
+			.reference_output = true,
+			.formats = true,
+		}};
+
+	}
+
+}
@@ -1,4 +1,10 @@
 #include <compute/blur/scene.hpp>
+#include <compute/blur/kernel.hpp>
+#include <compute/blur/downsampler.hpp>
+#include <compute/blur/format.hpp>
+#include <compute/blur/registry.hpp>
+#include <compute/blur/profiler.hpp>
+#include <compute/blur/frame_text.hpp>
 
 #include <psemek/gfx/array.hpp>
 #include <psemek/gfx/program.hpp>
@@ -39,9 +45,10 @@ void main()
 }
 )";
 
-		char const separable_linear_fragment[] =
-R"(#version 330
+		// M and the half kernel coeffs[M + 1] are prepended by make_program
 
+		char const separable_linear_fragment[] =
+R"(
 uniform sampler2D u_input_texture;
 uniform vec2 u_direction;
 
@@ -49,29 +56,6 @@ layout (location = 0) out vec4 out_color;
 
 in vec2 texcoord;
 
-const int M = 16;
-
-// sigma = 10
-const float coeffs[M + 1] = float[M + 1](
-	0.04425662519949865,
-	0.044035873841196206,
-	0.043380781642569775,
-	0.04231065439216247,
-	0.040856643282313365,
-	0.039060328279673276,
-	0.0369716985390341,
-	0.03464682117793548,
-	0.03214534135442581,
-	0.0295279624870386,
-	0.02685404941667096,
-	0.02417948052890078,
-	0.02155484948872149,
-	0.019024086115486723,
-	0.016623532195728208,
-	0.014381474814203989,
-	0.012318109844189502
-);
-
 void main()
 {
 	vec4 sum = coeffs[0] * texture(u_input_texture, texcoord);
@@ -111,80 +95,155 @@ void main()
 			gfx::framebuffer fbo_2_;
 			gfx::texture_2d color_buffer_2_;
 
-			gfx::program blur_program_{separable_linear_vertex, separable_linear_fragment};
+			gfx::framebuffer fbo_3_;
+			gfx::texture_2d color_buffer_3_;
+
+			shared_program blur_program_;
 
-			gfx::array vao_;
+			gfx::array & vao_ = services().fullscreen_vao;
 
-			gfx::painter painter_;
+			gfx::painter & painter_ = services().painter;
 
 			gfx::query_pool queries_;
 
 			util::moving_average<float> frame_time_{32};
 			util::moving_average<float> blur_time_{32};
+
+			downsampler downsampler_;
+			int kernel_radius_;
+			pixel_format format_ = pixel_format::rgba8;
+
+			shared_program make_program(char const * body) const;
+
+			blur_traffic traffic() const;
 		};
 
 		separable_linear_impl::separable_linear_impl()
+			: blur_program_{make_program(separable_linear_fragment)}
+			, kernel_radius_{blur_radius()}
 		{
 			color_buffer_1_.linear_filter();
 			color_buffer_1_.clamp();
 
 			color_buffer_2_.linear_filter();
 			color_buffer_2_.clamp();
+
+			color_buffer_3_.linear_filter();
+			color_buffer_3_.clamp();
+		}
+
+		shared_program separable_linear_impl::make_program(char const * body) const
+		{
+			return services().program(separable_linear_vertex, util::to_string("#version 330\n\n", gaussian_half_kernel_source(blur_sigma(), blur_radius()), body));
 		}
 
 		void separable_linear_impl::on_resize(int width, int height)
 		{
 			scene::on_resize(width, height);
 
+			if (kernel_radius_ != blur_radius())
+			{
+				kernel_radius_ = blur_radius();
+				blur_program_ = make_program(separable_linear_fragment);
+			}
+
 			color_buffer_1_.load<gfx::color_rgba>({width, height});
 			depth_buffer_1_.storage<gfx::depth24_pixel>({width, height});
 
-			color_buffer_2_.load<gfx::color_rgba>({width, height});
+			downsampler_.resize(width, height, render_scale());
+
+			format_ = intermediate_format();
+			load(color_buffer_2_, format_, scaled_width(), scaled_height());
+
+			color_buffer_3_.load<gfx::color_rgba>({scaled_width(), scaled_height()});
 
 			fbo_1_.color(color_buffer_1_);
 			fbo_1_.depth(depth_buffer_1_);
 
 			fbo_2_.color(color_buffer_2_);
 
+			fbo_3_.color(color_buffer_3_);
+
 			fbo_1_.assert_complete();
 			fbo_2_.assert_complete();
+			fbo_3_.assert_complete();
+
+			report_traffic(traffic());
+		}
+
+		blur_traffic separable_linear_impl::traffic() const
+		{
+			int const m = blur_radius();
+			int const n = 2 * m + 1;
+			int const bytes = pixel_format_bytes(format_);
+
+			// Each of the M + 1 bilinear fetches still reads two texels
+			blur_traffic traffic = direct_pass(scaled_width(), scaled_height(), n, 4, bytes, m + 1);
+			traffic += direct_pass(scaled_width(), scaled_height(), n, bytes, 4, m + 1);
+			return traffic;
 		}
 
 		void separable_linear_impl::present()
 		{
 			float const dt = clock_.restart().count();
 			frame_time_.push(dt);
+			begin_frame(dt);
 
 			fbo_1_.bind();
 			scene::draw();
 
 			{
-				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); });
+				profile_scope const submit_scope{"blur submit", true};
+
+				auto scope = queries_.begin(gl::TIME_ELAPSED, [this](GLint value){ blur_time_.push(value / 1e6f); report_blur_time(value / 1e6f); });
+
+				auto & input = downsampler_.apply(fbo_1_, color_buffer_1_);
 
 				fbo_2_.bind();
+				gl::Viewport(0, 0, scaled_width(), scaled_height());
 
 				gl::Clear(gl::COLOR_BUFFER_BIT);
 				gl::Disable(gl::DEPTH_TEST);
 
 				blur_program_.bind();
 				blur_program_["u_input_texture"] = 0;
-				blur_program_["u_direction"] = geom::vector{1.f / width(), 0.f};
-				color_buffer_1_.bind(0);
+				blur_program_["u_direction"] = geom::vector{1.f / scaled_width(), 0.f};
+				input.bind(0);
 				vao_.bind();
 
 				gl::DrawArrays(gl::TRIANGLES, 0, 3);
 
-				gfx::framebuffer::null().bind();
+				// At reduced resolution the vertical pass goes to an
+				// intermediate buffer which is then upsampled to the screen
+				if (render_scale() > 1)
+					fbo_3_.bind();
+				else
+					gfx::framebuffer::null().bind();
 
 				gl::Clear(gl::COLOR_BUFFER_BIT);
 
 				color_buffer_2_.bind(0);
-				blur_program_["u_direction"] = geom::vector{0.f, 1.f / height()};
+				blur_program_["u_direction"] = geom::vector{0.f, 1.f / scaled_height()};
 
 				gl::DrawArrays(gl::TRIANGLES, 0, 3);
+
+				if (render_scale() > 1)
+				{
+					gl::BindFramebuffer(gl::READ_FRAMEBUFFER, fbo_3_.id());
+					gl::BindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+					gl::BlitFramebuffer(0, 0, scaled_width(), scaled_height(), 0, 0, width(), height(), gl::COLOR_BUFFER_BIT, gl::LINEAR);
+
+					gfx::framebuffer::null().bind();
+				}
+
+				gl::Viewport(0, 0, width(), height());
 			}
 
+			output_ready();
+
 			{
+				profile_scope const hud_scope{"hud text"};
+
 				gfx::painter::text_options opts;
 				opts.scale = 2.f;
 				opts.c = gfx::black;
@@ -193,15 +252,30 @@ void main()
 
 				painter_.text({20.f, 20.f}, "Separable linear", opts);
 
-				painter_.text({20.f, 40.f}, util::to_string("FPS: ", 1.f / frame_time_.average()), opts);
+				painter_.text({20.f, 40.f}, frame_text("FPS: ", 1.f / frame_time_.average()), opts);
+
+				if (blur_time_.count() > 0)
+					painter_.text({20.f, 60.f}, frame_text("Blur: ", blur_time_.average(), "ms"), opts);
+
+				if (render_scale() > 1)
+					painter_.text({20.f, 80.f}, frame_text("Render scale: 1/", render_scale()), opts);
+
+				if (format_ != pixel_format::rgba8)
+					painter_.text({20.f, 100.f}, frame_text("Intermediate: ", pixel_format_name(format_)), opts);
 
 				if (blur_time_.count() > 0)
-					painter_.text({20.f, 60.f}, util::to_string("Blur: ", blur_time_.average(), "ms"), opts);
+					painter_.text({20.f, 120.f}, frame_text("Traffic: ", throughput{traffic(), blur_time_.average()}), opts);
 			}
 
-			painter_.render(geom::window_camera{width(), height()}.transform());
+			{
+				profile_scope const scope{"hud render"};
+				painter_.render(geom::window_camera{width(), height()}.transform());
+			}
 
-			queries_.poll();
+			{
+				profile_scope const scope{"query poll"};
+				queries_.poll();
+			}
 		}
 
 	}
@@ -211,4 +285,19 @@ void main()
 		return std::make_unique<separable_linear_impl>();
 	}
 
+	namespace
+	{
+
+		variant_registrar const separable_linear_registrar{{
+			.name = "separable_linear",
+			.factory = separable_linear,
+			.key = SDLK_3,
+			.passes = 2,
+			.scalable = true,
+			.reference_output = true,
+			.formats = true,
+		}};
+
+	}
+
 }
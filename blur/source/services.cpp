@@ -0,0 +1,30 @@
+#include <compute/blur/services.hpp>
+
+namespace compute
+{
+
+	shared_program renderer_services::program(std::string const & compute_source)
+	{
+		auto it = programs_.find(compute_source);
+		if (it == programs_.end())
+			it = programs_.try_emplace(compute_source, compute_source).first;
+		return shared_program{it->second};
+	}
+
+	shared_program renderer_services::program(std::string const & vertex_source, std::string const & fragment_source)
+	{
+		// The separator can't appear in GLSL source, so the key is unambiguous
+		auto key = vertex_source + '\0' + fragment_source;
+
+		auto it = programs_.find(key);
+		if (it == programs_.end())
+			it = programs_.try_emplace(std::move(key), vertex_source, fragment_source).first;
+		return shared_program{it->second};
+	}
+
+	std::size_t renderer_services::program_count() const
+	{
+		return programs_.size();
+	}
+
+}
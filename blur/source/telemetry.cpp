@@ -0,0 +1,363 @@
+#include <compute/blur/telemetry.hpp>
+
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	namespace
+	{
+
+		std::uint32_t const telemetry_magic = 0x626c7572;
+		std::uint32_t const telemetry_version = 1;
+
+		// A few seconds of records even at thousands of frames per second
+		std::uint64_t const record_count = 8192;
+
+		using clock_type = std::chrono::steady_clock;
+
+		static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+		static_assert(std::atomic<float>::is_always_lock_free);
+
+		// Every field is atomic, as the reader loads them while the producer may be storing.
+		// The sequence is the record index plus one once the record is complete, and zero
+		// while it is being written
+		struct record
+		{
+			std::atomic<std::uint64_t> sequence;
+			std::atomic<std::uint64_t> time;
+			std::atomic<std::uint32_t> kind;
+			std::atomic<float> ms;
+		};
+
+		// The magic is stored last when a producer initializes the segment, the head is the
+		// number of records published so far. They are on separate cache lines from the
+		// records, which the producer keeps writing
+		struct segment
+		{
+			std::atomic<std::uint32_t> magic;
+			std::uint32_t version;
+			std::uint32_t capacity;
+			std::atomic<std::uint32_t> producer;
+
+			alignas(64) std::atomic<std::uint64_t> head;
+
+			alignas(64) record records[record_count];
+		};
+
+		// Mapped for the lifetime of the process, the descriptor holds the producer lock
+		segment * published = nullptr;
+
+		std::uint64_t now_ns()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+		}
+
+		struct sample
+		{
+			std::uint64_t time;
+			float ms;
+		};
+
+		// Samples of one kind received within the window
+		struct sample_window
+		{
+			std::deque<sample> samples;
+
+			void expire(std::uint64_t oldest)
+			{
+				while (!samples.empty() && samples.front().time < oldest)
+					samples.pop_front();
+			}
+
+			void report(char const * name, std::ostream & output) const
+			{
+				output << name << ": ";
+
+				if (samples.empty())
+				{
+					output << "no samples";
+					return;
+				}
+
+				std::vector<float> sorted;
+				sorted.reserve(samples.size());
+				for (auto const & s : samples)
+					sorted.push_back(s.ms);
+				std::sort(sorted.begin(), sorted.end());
+
+				// Nearest rank
+				auto percentile = [&](double p){
+					std::size_t rank = static_cast<std::size_t>(p * sorted.size());
+					return sorted[std::min(rank, sorted.size() - 1)];
+				};
+
+				output << "p50 " << percentile(0.5) << "ms, p90 " << percentile(0.9) << "ms, p99 " << percentile(0.99)
+					<< "ms, max " << sorted.back() << "ms (" << sorted.size() << " samples)";
+			}
+		};
+
+		// A read-only mapping of the segment of a producer, if one has initialized it
+		struct reader
+		{
+			explicit reader(std::string const & name)
+			{
+				fd_ = ::shm_open(name.c_str(), O_RDONLY, 0);
+				if (fd_ == -1)
+					return;
+
+				struct stat info;
+				if (::fstat(fd_, &info) != 0 || std::size_t(info.st_size) < sizeof(segment))
+					return;
+
+				void * data = ::mmap(nullptr, sizeof(segment), PROT_READ, MAP_SHARED, fd_, 0);
+				if (data == MAP_FAILED)
+					return;
+
+				segment_ = static_cast<segment const *>(data);
+			}
+
+			~reader()
+			{
+				if (segment_)
+					::munmap(const_cast<segment *>(segment_), sizeof(segment));
+				if (fd_ != -1)
+					::close(fd_);
+			}
+
+			reader(reader const &) = delete;
+			reader & operator = (reader const &) = delete;
+
+			bool ready() const
+			{
+				return segment_ && segment_->magic.load(std::memory_order_acquire) == telemetry_magic
+					&& segment_->version == telemetry_version && segment_->capacity == record_count;
+			}
+
+			segment const & get() const { return *segment_; }
+
+		private:
+			int fd_ = -1;
+			segment const * segment_ = nullptr;
+		};
+
+		// Seqlock read: the record is valid if it carries the expected sequence both before
+		// and after its fields were loaded
+		bool read_record(record const & r, std::uint64_t sequence, telemetry_kind & kind, sample & result)
+		{
+			if (r.sequence.load(std::memory_order_acquire) != sequence)
+				return false;
+
+			result.time = r.time.load(std::memory_order_relaxed);
+			result.ms = r.ms.load(std::memory_order_relaxed);
+			kind = static_cast<telemetry_kind>(r.kind.load(std::memory_order_relaxed));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return r.sequence.load(std::memory_order_relaxed) == sequence;
+		}
+
+	}
+
+	void start_telemetry(std::string const & name)
+	{
+		int const fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd == -1)
+			throw std::runtime_error(util::to_string("Failed to open shared memory ", name));
+
+		// Held until the process exits, keeping the ring single-producer
+		if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+		{
+			::close(fd);
+			throw std::runtime_error(util::to_string("Another process is publishing to ", name));
+		}
+
+		if (::ftruncate(fd, sizeof(segment)) != 0)
+		{
+			::close(fd);
+			throw std::runtime_error(util::to_string("Failed to resize shared memory ", name));
+		}
+
+		void * data = ::mmap(nullptr, sizeof(segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			::close(fd);
+			throw std::runtime_error(util::to_string("Failed to map shared memory ", name));
+		}
+
+		// The segment may be left over from a previous producer: readers ignore it until the
+		// magic is stored again, and notice the new producer by its pid
+		auto & s = *static_cast<segment *>(data);
+		s.magic.store(0, std::memory_order_release);
+		s.version = telemetry_version;
+		s.capacity = record_count;
+		s.head.store(0, std::memory_order_relaxed);
+		for (auto & r : s.records)
+			r.sequence.store(0, std::memory_order_relaxed);
+		s.producer.store(static_cast<std::uint32_t>(::getpid()), std::memory_order_relaxed);
+		s.magic.store(telemetry_magic, std::memory_order_release);
+
+		published = &s;
+	}
+
+	void publish_telemetry(telemetry_kind kind, float ms)
+	{
+		if (!published)
+			return;
+
+		auto & s = *published;
+
+		// Only this thread stores the head
+		auto const index = s.head.load(std::memory_order_relaxed);
+		auto & r = s.records[index % record_count];
+
+		r.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		r.time.store(now_ns(), std::memory_order_relaxed);
+		r.kind.store(static_cast<std::uint32_t>(kind), std::memory_order_relaxed);
+		r.ms.store(ms, std::memory_order_relaxed);
+
+		r.sequence.store(index + 1, std::memory_order_release);
+		s.head.store(index + 1, std::memory_order_release);
+	}
+
+	bool parse_monitor_options(int argc, char ** argv, monitor_options & options)
+	{
+		if (argc < 2 || std::string(argv[1]) != "--monitor")
+			return false;
+
+		for (int i = 2; i < argc; i += 2)
+		{
+			std::string const name = argv[i];
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			std::string const value = argv[i + 1];
+
+			if (name == "--name")
+				options.name = value;
+			else if (name == "--interval")
+				options.interval = std::stof(value);
+			else if (name == "--window")
+				options.window = std::stof(value);
+			else
+				throw std::runtime_error(util::to_string("Unknown option ", name));
+		}
+
+		if (options.name.empty() || options.name[0] != '/')
+			throw std::runtime_error("Shared memory name must start with /");
+
+		if (!(options.interval > 0.f) || !(options.window > 0.f))
+			throw std::runtime_error("Interval and window must be positive");
+
+		return true;
+	}
+
+	void run_monitor(monitor_options const & options, std::ostream & output)
+	{
+		// Often enough that the producer can't lap the reader between polls
+		auto const poll_period = std::chrono::milliseconds(50);
+		auto const report_period = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<float>(options.interval));
+		auto const window_ns = static_cast<std::uint64_t>(options.window * 1e9);
+
+		std::unique_ptr<reader> source;
+		bool waiting = false;
+
+		std::uint32_t producer = 0;
+		std::uint64_t next = 0;
+		std::uint64_t missed = 0;
+
+		sample_window frame_samples;
+		sample_window blur_samples;
+
+		auto next_report = clock_type::now() + report_period;
+
+		while (true)
+		{
+			if (!source || !source->ready())
+			{
+				source = std::make_unique<reader>(options.name);
+				if (!source->ready())
+				{
+					if (!waiting)
+						output << "Waiting for a renderer publishing to " << options.name << std::endl;
+					waiting = true;
+					std::this_thread::sleep_for(report_period);
+					continue;
+				}
+			}
+
+			auto const & s = source->get();
+			auto const head = s.head.load(std::memory_order_acquire);
+
+			if (auto const pid = s.producer.load(std::memory_order_relaxed); pid != producer || head < next)
+			{
+				producer = pid;
+				next = head - std::min(head, record_count);
+				missed = 0;
+				frame_samples.samples.clear();
+				blur_samples.samples.clear();
+				waiting = false;
+				output << "Monitoring renderer " << pid << std::endl;
+			}
+
+			// Records older than a ring have been overwritten
+			if (head - next > record_count)
+			{
+				missed += head - next - record_count;
+				next = head - record_count;
+			}
+
+			for (; next < head; ++next)
+			{
+				telemetry_kind kind;
+				sample value;
+				if (!read_record(s.records[next % record_count], next + 1, kind, value))
+				{
+					++missed;
+					continue;
+				}
+
+				(kind == telemetry_kind::frame ? frame_samples : blur_samples).samples.push_back(value);
+			}
+
+			if (auto const now = clock_type::now(); now >= next_report)
+			{
+				next_report = now + report_period;
+
+				auto const oldest = now_ns() - std::min(now_ns(), window_ns);
+				frame_samples.expire(oldest);
+				blur_samples.expire(oldest);
+
+				frame_samples.report("Frame", output);
+				output << " | ";
+				blur_samples.report("Blur", output);
+				if (missed > 0)
+					output << " | missed " << missed;
+				output << std::endl;
+			}
+
+			std::this_thread::sleep_for(poll_period);
+		}
+	}
+
+}
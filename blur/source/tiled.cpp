@@ -0,0 +1,413 @@
+#include <compute/blur/tiled.hpp>
+#include <compute/blur/batch.hpp>
+
+#include <psemek/gfx/gl.hpp>
+#include <psemek/gfx/painter.hpp>
+#include <psemek/geom/camera.hpp>
+#include <psemek/util/to_string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace compute
+{
+
+	namespace
+	{
+
+		// A file mapped into memory in its entirety, read-only or read-write
+		struct mapped_file
+		{
+			mapped_file(std::filesystem::path const & path, std::size_t size, bool writable)
+				: size_(size)
+			{
+				fd_ = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+				if (fd_ == -1)
+					throw std::runtime_error(util::to_string("Failed to open ", path.string()));
+
+				if (writable && ::ftruncate(fd_, size) != 0)
+				{
+					::close(fd_);
+					throw std::runtime_error(util::to_string("Failed to resize ", path.string()));
+				}
+
+				if (!writable)
+				{
+					struct stat info;
+					if (::fstat(fd_, &info) != 0 || std::size_t(info.st_size) < size)
+					{
+						::close(fd_);
+						throw std::runtime_error(util::to_string(path.string(), " is smaller than the image size"));
+					}
+				}
+
+				void * data = ::mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd_, 0);
+				if (data == MAP_FAILED)
+				{
+					::close(fd_);
+					throw std::runtime_error(util::to_string("Failed to map ", path.string()));
+				}
+
+				data_ = static_cast<std::uint8_t *>(data);
+
+				// Tiles are visited in row order
+				::madvise(data_, size_, MADV_SEQUENTIAL);
+			}
+
+			~mapped_file()
+			{
+				::munmap(data_, size_);
+				::close(fd_);
+			}
+
+			mapped_file(mapped_file const &) = delete;
+			mapped_file & operator = (mapped_file const &) = delete;
+
+			std::uint8_t * data() const { return data_; }
+
+			// Lets the kernel drop the pages of a range that won't be accessed again,
+			// writing them back first if they are dirty, which bounds the resident memory
+			void release(std::size_t offset, std::size_t size)
+			{
+				std::size_t const page = ::sysconf(_SC_PAGESIZE);
+				std::size_t const begin = (offset / page) * page;
+				std::size_t const end = std::min(size_, offset + size);
+				if (end <= begin)
+					return;
+
+				::msync(data_ + begin, end - begin, MS_ASYNC);
+				::madvise(data_ + begin, end - begin, MADV_DONTNEED);
+			}
+
+		private:
+			int fd_ = -1;
+			std::uint8_t * data_ = nullptr;
+			std::size_t size_ = 0;
+		};
+
+		struct tile
+		{
+			// The part written to the output
+			int x, y, width, height;
+
+			// The uploaded part, extended by the apron and clipped to the image
+			int apron_x, apron_y, apron_width, apron_height;
+		};
+
+		struct tile_slot
+		{
+			GLuint upload_buffer = 0;
+			GLuint readback_buffer = 0;
+			GLsync fence = nullptr;
+
+			bool busy = false;
+			tile t;
+		};
+
+		constexpr int slot_count = 2;
+
+		struct tiled_impl
+			: scene
+		{
+			tiled_impl(tiled_options options);
+			~tiled_impl();
+
+			void present() override;
+
+		private:
+			tiled_options options_;
+
+			batch_blur blur_;
+
+			tile_slot slots_[slot_count];
+
+			bool finished_ = false;
+			std::vector<std::string> summary_;
+
+			gfx::painter & painter_ = services().painter;
+
+			void run();
+
+			// Waits for the readback of the slot and copies it into the output, throws if the
+			// readback failed
+			void retire(tile_slot & slot, mapped_file & output);
+		};
+
+		tiled_impl::tiled_impl(tiled_options options)
+			: options_(std::move(options))
+			, blur_(options_.sigma, options_.radius)
+		{
+			int const size = options_.tile_size + 2 * options_.radius;
+
+			GLint max_size = 0;
+			gl::GetIntegerv(gl::MAX_TEXTURE_SIZE, &max_size);
+			if (size > max_size)
+				throw std::runtime_error(util::to_string("Tile of ", size, " pixels with the apron exceeds the texture size limit of ", max_size));
+
+			blur_.resize(size, size, slot_count);
+
+			for (auto & slot : slots_)
+			{
+				gl::GenBuffers(1, &slot.upload_buffer);
+				gl::GenBuffers(1, &slot.readback_buffer);
+			}
+		}
+
+		tiled_impl::~tiled_impl()
+		{
+			for (auto & slot : slots_)
+			{
+				if (slot.fence)
+					gl::DeleteSync(slot.fence);
+
+				gl::DeleteBuffers(1, &slot.upload_buffer);
+				gl::DeleteBuffers(1, &slot.readback_buffer);
+			}
+		}
+
+		void tiled_impl::retire(tile_slot & slot, mapped_file & output)
+		{
+			GLenum status;
+			while ((status = gl::ClientWaitSync(slot.fence, gl::SYNC_FLUSH_COMMANDS_BIT, 1000000)) == gl::TIMEOUT_EXPIRED)
+			{}
+
+			gl::DeleteSync(slot.fence);
+			slot.fence = nullptr;
+			slot.busy = false;
+
+			// The buffer may not hold the blurred tile yet
+			if (status == gl::WAIT_FAILED)
+				throw std::runtime_error("Waiting for the readback of a tile failed");
+
+			auto const & t = slot.t;
+			std::size_t const row_bytes = std::size_t(t.width) * 4;
+			std::size_t const stride = std::size_t(options_.width) * 4;
+
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, slot.readback_buffer);
+			auto mapped = static_cast<std::uint8_t const *>(gl::MapBufferRange(gl::PIXEL_PACK_BUFFER, 0, row_bytes * t.height, gl::MAP_READ_BIT));
+			if (!mapped)
+			{
+				gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+				throw std::runtime_error("Mapping the readback of a tile failed");
+			}
+
+			for (int row = 0; row < t.height; ++row)
+				std::memcpy(output.data() + (t.y + row) * stride + std::size_t(t.x) * 4, mapped + row * row_bytes, row_bytes);
+
+			// The contents were lost while mapped, e.g. on a mode switch
+			bool const intact = gl::UnmapBuffer(gl::PIXEL_PACK_BUFFER);
+			gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+			if (!intact)
+				throw std::runtime_error("The readback of a tile was corrupted");
+		}
+
+		void tiled_impl::run()
+		{
+			finished_ = true;
+
+			auto const start = std::chrono::steady_clock::now();
+
+			std::size_t const stride = std::size_t(options_.width) * 4;
+			std::size_t const bytes = stride * options_.height;
+
+			mapped_file input(options_.input, bytes, false);
+			mapped_file output(options_.output, bytes, true);
+
+			int const tile_size = options_.tile_size;
+			int const radius = options_.radius;
+
+			std::size_t index = 0;
+			std::size_t released_input_rows = 0;
+			std::size_t released_output_rows = 0;
+
+			for (int y = 0; y < options_.height; y += tile_size)
+			{
+				for (int x = 0; x < options_.width; x += tile_size, ++index)
+				{
+					tile t;
+					t.x = x;
+					t.y = y;
+					t.width = std::min(tile_size, options_.width - x);
+					t.height = std::min(tile_size, options_.height - y);
+					t.apron_x = std::max(0, x - radius);
+					t.apron_y = std::max(0, y - radius);
+					t.apron_width = std::min(options_.width, x + t.width + radius) - t.apron_x;
+					t.apron_height = std::min(options_.height, y + t.height + radius) - t.apron_y;
+
+					auto & slot = slots_[index % slot_count];
+					if (slot.busy)
+						retire(slot, output);
+
+					int const layer = index % slot_count;
+					std::size_t const row_bytes = std::size_t(t.apron_width) * 4;
+
+					// Copying the rows of this tile overlaps with the blur of the previous one
+					gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, slot.upload_buffer);
+					gl::BufferData(gl::PIXEL_UNPACK_BUFFER, row_bytes * t.apron_height, nullptr, gl::STREAM_DRAW);
+					auto mapped = static_cast<std::uint8_t *>(gl::MapBufferRange(gl::PIXEL_UNPACK_BUFFER, 0, row_bytes * t.apron_height, gl::MAP_WRITE_BIT | gl::MAP_INVALIDATE_BUFFER_BIT));
+					if (!mapped)
+					{
+						gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+						throw std::runtime_error("Mapping the upload of a tile failed");
+					}
+
+					for (int row = 0; row < t.apron_height; ++row)
+						std::memcpy(mapped + row * row_bytes, input.data() + (t.apron_y + row) * stride + std::size_t(t.apron_x) * 4, row_bytes);
+
+					if (!gl::UnmapBuffer(gl::PIXEL_UNPACK_BUFFER))
+					{
+						gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+						throw std::runtime_error("The upload of a tile was corrupted");
+					}
+
+					blur_.upload(layer, nullptr, t.apron_width, t.apron_height);
+					gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+					blur_.apply(layer, 1, t.apron_width, t.apron_height);
+
+					gl::BindBuffer(gl::PIXEL_PACK_BUFFER, slot.readback_buffer);
+					gl::BufferData(gl::PIXEL_PACK_BUFFER, std::size_t(t.width) * 4 * t.height, nullptr, gl::STREAM_READ);
+					blur_.download(layer, t.x - t.apron_x, t.y - t.apron_y, t.width, t.height, nullptr);
+					gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+
+					slot.fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+					gl::Flush();
+
+					slot.busy = true;
+					slot.t = t;
+				}
+
+				// Rows above the apron of the next row of tiles are not read again, and rows of
+				// the output above the tiles still in flight are complete
+				int const next_apron = std::max(0, y + tile_size - radius);
+				int const in_flight = std::max(0, y - tile_size);
+				std::size_t const input_rows = std::min<std::size_t>(next_apron, options_.height);
+				std::size_t const output_rows = std::min<std::size_t>(in_flight, options_.height);
+				if (input_rows > released_input_rows)
+				{
+					input.release(released_input_rows * stride, (input_rows - released_input_rows) * stride);
+					released_input_rows = input_rows;
+				}
+				if (output_rows > released_output_rows)
+				{
+					output.release(released_output_rows * stride, (output_rows - released_output_rows) * stride);
+					released_output_rows = output_rows;
+				}
+			}
+
+			for (std::size_t i = 0; i < slot_count; ++i)
+			{
+				auto & slot = slots_[(index + i) % slot_count];
+				if (slot.busy)
+					retire(slot, output);
+			}
+
+			double const total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			summary_.push_back(util::to_string("Blurred ", options_.width, "x", options_.height, " in ", index, " tiles of ", tile_size, "x", tile_size, " in ", total, "s"));
+			summary_.push_back(util::to_string("Throughput: ", bytes / (total * 1e6), "MB/s"));
+			summary_.push_back(util::to_string("Result written to ", options_.output.string()));
+
+			for (auto const & line : summary_)
+				std::cout << line << std::endl;
+		}
+
+		void tiled_impl::present()
+		{
+			if (!finished_)
+			{
+				try
+				{
+					run();
+				}
+				catch (std::exception const & e)
+				{
+					summary_.push_back(e.what());
+					std::cout << e.what() << std::endl;
+				}
+			}
+
+			gfx::framebuffer::null().bind();
+			gl::Viewport(0, 0, width(), height());
+			gl::ClearColor(0.8f, 0.8f, 1.f, 0.f);
+			gl::Clear(gl::COLOR_BUFFER_BIT);
+
+			gfx::painter::text_options opts;
+			opts.scale = 2.f;
+			opts.c = gfx::black;
+			opts.x = gfx::painter::x_align::left;
+			opts.y = gfx::painter::y_align::top;
+
+			float y = 20.f;
+			for (auto const & line : summary_)
+			{
+				painter_.text({20.f, y}, line, opts);
+				y += 20.f;
+			}
+
+			painter_.render(geom::window_camera{width(), height()}.transform());
+		}
+
+	}
+
+	bool parse_tiled_options(int argc, char ** argv, tiled_options & options)
+	{
+		if (argc < 2 || std::string(argv[1]) != "--tiled")
+			return false;
+
+		if (argc < 6)
+			throw std::runtime_error("Usage: blur --tiled <input> <output> <width> <height> [--tile T] [--sigma S] [--radius R]");
+
+		options.input = argv[2];
+		options.output = argv[3];
+		options.width = std::stoi(argv[4]);
+		options.height = std::stoi(argv[5]);
+
+		if (options.width <= 0 || options.height <= 0)
+			throw std::runtime_error("Image size must be positive");
+
+		for (int i = 6; i < argc; i += 2)
+		{
+			std::string const name = argv[i];
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			std::string const value = argv[i + 1];
+
+			if (name == "--tile")
+				options.tile_size = std::max(1, std::stoi(value));
+			else if (name == "--sigma")
+				options.sigma = std::stof(value);
+			else if (name == "--radius")
+				options.radius = std::stoi(value);
+			else
+				throw std::runtime_error(util::to_string("Unknown option ", name));
+		}
+
+		return true;
+	}
+
+	std::unique_ptr<scene> tiled(tiled_options options)
+	{
+		if (!gl::sys::ext_ARB_compute_shader())
+			throw std::runtime_error("OpenGL extension ARB_compute_shader not supported");
+
+		if (!gl::sys::ext_ARB_shader_image_load_store())
+			throw std::runtime_error("OpenGL extension ARB_shader_image_load_store not supported");
+
+		return std::make_unique<tiled_impl>(std::move(options));
+	}
+
+}
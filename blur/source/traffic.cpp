@@ -0,0 +1,128 @@
+#include <compute/blur/traffic.hpp>
+
+#include <psemek/util/to_string.hpp>
+
+#include <stdexcept>
+#include <string>
+
+namespace compute
+{
+
+	using namespace psemek;
+
+	namespace
+	{
+
+		throughput_peak current_peak;
+
+	}
+
+	double blur_traffic::intensity() const
+	{
+		return global_bytes() > 0.0 ? taps / global_bytes() : 0.0;
+	}
+
+	blur_traffic & blur_traffic::operator += (blur_traffic const & other)
+	{
+		global_read += other.global_read;
+		global_written += other.global_written;
+		lds_read += other.lds_read;
+		lds_written += other.lds_written;
+		taps += other.taps;
+		return *this;
+	}
+
+	blur_traffic direct_pass(int width, int height, double fetches, int read_bytes, int write_bytes, double taps)
+	{
+		double const pixels = double(width) * height;
+
+		blur_traffic result;
+		result.global_read = pixels * fetches * read_bytes;
+		result.global_written = pixels * write_bytes;
+		result.taps = pixels * taps;
+		return result;
+	}
+
+	blur_traffic cached_pass(int width, int height, int tile_x, int tile_y, int cache_elements, int read_bytes, int element_bytes,
+		int write_bytes, double cache_reads, double taps)
+	{
+		double const pixels = double(width) * height;
+		double const groups = double((width + tile_x - 1) / tile_x) * ((height + tile_y - 1) / tile_y);
+
+		blur_traffic result;
+		result.global_read = groups * cache_elements * read_bytes;
+		result.global_written = pixels * write_bytes;
+		result.lds_written = groups * cache_elements * element_bytes;
+		result.lds_read = pixels * cache_reads * element_bytes;
+		result.taps = pixels * taps;
+		return result;
+	}
+
+	throughput_peak const & peak()
+	{
+		return current_peak;
+	}
+
+	void set_peak(throughput_peak peak)
+	{
+		current_peak = peak;
+	}
+
+	bool parse_peak_options(int & argc, char ** argv, throughput_peak & peak)
+	{
+		bool found = false;
+		int kept = 1;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string const name = argv[i];
+			if (name != "--peak-bandwidth" && name != "--peak-taps")
+			{
+				argv[kept++] = argv[i];
+				continue;
+			}
+
+			if (i + 1 == argc)
+				throw std::runtime_error(util::to_string("Missing value of ", name));
+
+			double const value = std::stod(argv[++i]);
+			if (value <= 0.0)
+				throw std::runtime_error(util::to_string(name, " must be positive"));
+
+			if (name == "--peak-bandwidth")
+				peak.bandwidth = value;
+			else
+				peak.taps = value;
+
+			found = true;
+		}
+
+		argc = kept;
+		return found;
+	}
+
+	std::ostream & operator << (std::ostream & stream, throughput const & value)
+	{
+		if (value.ms <= 0.f)
+			return stream;
+
+		auto const & traffic = value.traffic;
+
+		// Bytes per millisecond are 1e-6 GB/s
+		double const global = traffic.global_bytes() / (value.ms * 1e6);
+		double const lds = traffic.lds_bytes() / (value.ms * 1e6);
+		double const taps = traffic.taps / (value.ms * 1e6);
+
+		stream << global << " GB/s, LDS " << lds << " GB/s, " << taps << " Gtaps/s, " << traffic.intensity() << " taps/B";
+
+		if (current_peak.bandwidth > 0.0)
+			stream << ", " << 100.0 * global / current_peak.bandwidth << "% of peak";
+
+		// The ridge point of the roofline: below it the peak bandwidth limits the tap rate
+		if (current_peak.bandwidth > 0.0 && current_peak.taps > 0.0)
+			stream << ((traffic.intensity() < current_peak.taps / current_peak.bandwidth) ? ", bandwidth-bound" : ", ALU-bound");
+
+		return stream;
+	}
+
+}